@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace ee {
+
+namespace {
+
+std::byte* align_up(std::byte* ptr, std::size_t alignment) {
+    const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+
+    return ptr + ((alignment - address % alignment) % alignment);
+}
+
+} // namespace
+
+Arena::Arena(std::size_t chunk_size) :
+    chunk_size_{chunk_size} {}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment) {
+    std::byte* ptr = ptr_ ? align_up(ptr_, alignment) : nullptr;
+
+    if ( ! ptr || ptr + size > end_) {
+        next_chunk(size, alignment);
+        ptr = align_up(ptr_, alignment);
+    }
+
+    ptr_ = ptr + size;
+
+    return ptr;
+}
+
+void Arena::reset() {
+    if (chunks_.size() > 1) {
+        const std::size_t total = capacity();
+
+        chunks_.clear();
+        chunks_.push_back({
+            std::unique_ptr<std::byte[], Free>(
+                static_cast<std::byte*>(::operator new[](total, std::align_val_t{cache_line}))),
+            total
+        });
+    }
+
+    current_ = 0;
+    used_before_ = 0;
+    ptr_ = chunks_.empty() ? nullptr : chunks_[0].data.get();
+    end_ = chunks_.empty() ? nullptr : ptr_ + chunks_[0].size;
+}
+
+std::size_t Arena::capacity() const {
+    std::size_t total = 0;
+
+    for (const Chunk& chunk : chunks_) {
+        total += chunk.size;
+    }
+
+    return total;
+}
+
+std::size_t Arena::used() const {
+    return ptr_ ? used_before_ + (ptr_ - chunks_[current_].data.get()) : 0;
+}
+
+/**
+ * Move to the next chunk able to hold size bytes aligned on alignment,
+ * allocating one if needed.
+ */
+void Arena::next_chunk(std::size_t size, std::size_t alignment) {
+    const std::size_t needed = size + (alignment > cache_line ? alignment : 0);
+
+    if (ptr_) {
+        used_before_ += chunks_[current_].size;
+        ++ current_;
+    }
+
+    while (current_ < chunks_.size() && chunks_[current_].size < needed) {
+        used_before_ += chunks_[current_].size;
+        ++ current_;
+    }
+
+    if (current_ == chunks_.size()) {
+        const std::size_t chunk = std::max(chunk_size_, needed);
+
+        chunks_.push_back({
+            std::unique_ptr<std::byte[], Free>(
+                static_cast<std::byte*>(::operator new[](chunk, std::align_val_t{cache_line}))),
+            chunk
+        });
+    }
+
+    ptr_ = chunks_[current_].data.get();
+    end_ = ptr_ + chunks_[current_].size;
+}
+
+} // namespace ee
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ee {
+
+/**
+ * Bump allocator for scratch memory. Allocations are only released all at
+ * once by reset(), which keeps the memory: after a reset following growth the
+ * chunks are merged in one so that the same workload no longer allocates.
+ * Chunks are aligned on cache lines.
+ */
+class Arena {
+    public:
+        static constexpr std::size_t cache_line = 64;
+
+        explicit Arena(std::size_t chunk_size = 64 * 1024);
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+        /**
+         * Uninitialized storage for count T.
+         */
+        template <typename T>
+        T* allocate(std::size_t count = 1) {
+            return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        /**
+         * T is never destroyed, so it has to be trivially destructible.
+         */
+        template <typename T, typename... Args>
+        T* make(Args&&... args) {
+            static_assert(std::is_trivially_destructible<T>::value, "Arena never calls destructors");
+
+            return new (allocate<T>()) T(std::forward<Args>(args)...);
+        }
+
+        void reset();
+
+        std::size_t capacity() const;
+        std::size_t used() const;
+
+    private:
+        struct Free {
+            void operator()(std::byte* data) const {
+                ::operator delete[](data, std::align_val_t{cache_line});
+            }
+        };
+
+        struct Chunk {
+            std::unique_ptr<std::byte[], Free> data;
+            std::size_t size;
+        };
+
+        void next_chunk(std::size_t, std::size_t);
+
+        std::size_t chunk_size_;
+        std::vector<Chunk> chunks_;
+        std::size_t current_ = 0;
+        std::size_t used_before_ = 0;
+        std::byte* ptr_ = nullptr;
+        std::byte* end_ = nullptr;
+};
+
+} // namespace ee
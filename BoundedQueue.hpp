@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace ee {
+
+/**
+ * Bounded lock-free multi producer multi consumer FIFO, after D. Vyukov's
+ * array based queue. Capacity is rounded up to a power of two and all cells
+ * are allocated by the constructor, pushing and popping never allocate.
+ * Each cell carries a sequence number telling whether it is ready to be
+ * written or read for a given lap, producers and consumers each claim cells
+ * with a CAS on their own position.
+ */
+template <typename T>
+class BoundedQueue {
+    public:
+        explicit BoundedQueue(std::size_t capacity);
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        std::size_t capacity() const {
+            return mask_ + 1;
+        }
+
+        /**
+         * Move value in unless the queue is full, value is left untouched
+         * then.
+         */
+        bool try_push(T&& value);
+
+        /**
+         * Move the oldest value out unless the queue is empty.
+         */
+        bool try_pop(T& value);
+
+    private:
+        static constexpr std::size_t cache_line = 64;
+
+        struct Cell {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        std::size_t mask_;
+        std::unique_ptr<Cell[]> cells_;
+
+        alignas(cache_line) std::atomic<std::size_t> push_position_{0};
+        alignas(cache_line) std::atomic<std::size_t> pop_position_{0};
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(std::size_t capacity) {
+    std::size_t rounded = 2;
+
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+
+    mask_ = rounded - 1;
+    cells_ = std::make_unique<Cell[]>(rounded);
+
+    for (std::size_t i = 0; i < rounded; ++ i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool BoundedQueue<T>::try_push(T&& value) {
+    std::size_t position = push_position_.load(std::memory_order_relaxed);
+
+    while (true) {
+        Cell& cell = cells_[position & mask_];
+        const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+
+        if (lag == 0) {
+            if (push_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell.value = std::move(value);
+                cell.sequence.store(position + 1, std::memory_order_release);
+
+                return true;
+            }
+        }
+        else if (lag < 0) {
+            // the cell still holds the value of the previous lap
+            return false;
+        }
+        else {
+            position = push_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool BoundedQueue<T>::try_pop(T& value) {
+    std::size_t position = pop_position_.load(std::memory_order_relaxed);
+
+    while (true) {
+        Cell& cell = cells_[position & mask_];
+        const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const auto lag = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+
+        if (lag == 0) {
+            if (pop_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                value = std::move(cell.value);
+                cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+
+                return true;
+            }
+        }
+        else if (lag < 0) {
+            // the cell has not been written for this lap yet
+            return false;
+        }
+        else {
+            position = pop_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+} // namespace ee
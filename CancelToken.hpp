@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+namespace ee {
+
+/**
+ * Reported by the Future or TaskGroup of a task dropped before it ran.
+ */
+class Cancelled : public std::runtime_error {
+    public:
+        Cancelled() :
+            std::runtime_error("task cancelled") {}
+};
+
+/**
+ * Cooperative cancellation flag shared by all copies of a token, optionally
+ * with a deadline past which it reads as cancelled. Tasks submitted with a
+ * token are dropped if it is cancelled by the time they start, running code
+ * polls cancelled() where it is convenient to stop.
+ */
+class CancelToken {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        CancelToken() :
+            CancelToken(Clock::time_point::max()) {}
+
+        explicit CancelToken(Clock::time_point deadline) :
+            state_{std::make_shared<State>(deadline)} {}
+
+        explicit CancelToken(Clock::duration timeout) :
+            CancelToken(Clock::now() + timeout) {}
+
+        void cancel() {
+            state_->cancelled.store(true, std::memory_order_release);
+        }
+
+        bool cancelled() const {
+            if (state_->cancelled.load(std::memory_order_acquire)) {
+                return true;
+            }
+
+            if (state_->deadline != Clock::time_point::max() && Clock::now() >= state_->deadline) {
+                // spare later calls the clock read
+                state_->cancelled.store(true, std::memory_order_release);
+                return true;
+            }
+
+            return false;
+        }
+
+        Clock::time_point deadline() const {
+            return state_->deadline;
+        }
+
+    private:
+        struct State {
+            explicit State(Clock::time_point deadline) :
+                deadline{deadline} {}
+
+            std::atomic<bool> cancelled{false};
+            const Clock::time_point deadline;
+        };
+
+        std::shared_ptr<State> state_;
+};
+
+} // namespace ee
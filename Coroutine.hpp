@@ -0,0 +1,425 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#if ! defined(__cpp_impl_coroutine)
+#error "Coroutine.hpp requires C++20 coroutines"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace ee {
+
+template <typename T = void>
+class CoTask;
+
+namespace detail {
+
+template <typename T>
+class CoPromiseBase {
+    public:
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        /**
+         * Hand the thread over to whoever awaits the task.
+         */
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                auto continuation = handle.promise().continuation_;
+
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void unhandled_exception() {
+            exception_ = std::current_exception();
+        }
+
+        void set_continuation(std::coroutine_handle<> continuation) {
+            continuation_ = continuation;
+        }
+
+    protected:
+        void rethrow() {
+            if (exception_) {
+                std::rethrow_exception(exception_);
+            }
+        }
+
+    private:
+        std::coroutine_handle<> continuation_;
+        std::exception_ptr exception_;
+};
+
+template <typename T>
+class CoPromise : public CoPromiseBase<T> {
+    public:
+        CoTask<T> get_return_object();
+
+        template <typename U>
+        void return_value(U&& value) {
+            value_.emplace(std::forward<U>(value));
+        }
+
+        T result() {
+            this->rethrow();
+
+            return std::move(*value_);
+        }
+
+    private:
+        std::optional<T> value_;
+};
+
+template <>
+class CoPromise<void> : public CoPromiseBase<void> {
+    public:
+        CoTask<void> get_return_object();
+
+        void return_void() {}
+
+        void result() {
+            rethrow();
+        }
+};
+
+} // namespace detail
+
+/**
+ * Lazy coroutine producing a T, started when awaited. Awaiting it from
+ * another CoTask chains them without blocking any thread, combined with
+ * co_await pool.schedule() a suspended CoTask holds no pool thread.
+ * T may not be a reference.
+ */
+template <typename T>
+class [[nodiscard]] CoTask {
+    public:
+        using promise_type = detail::CoPromise<T>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        CoTask() = default;
+
+        explicit CoTask(handle_type handle) :
+            handle_{handle} {}
+
+        CoTask(CoTask&& other) noexcept :
+            handle_{std::exchange(other.handle_, nullptr)} {}
+
+        CoTask& operator=(CoTask&& other) noexcept {
+            if (this != &other) {
+                if (handle_) {
+                    handle_.destroy();
+                }
+
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~CoTask() {
+            if (handle_) {
+                handle_.destroy();
+            }
+        }
+
+        bool valid() const {
+            return static_cast<bool>(handle_);
+        }
+
+        auto operator co_await() && noexcept {
+            struct Awaiter {
+                handle_type handle;
+
+                bool await_ready() noexcept {
+                    return handle.done();
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                    handle.promise().set_continuation(awaiting);
+
+                    return handle;
+                }
+
+                T await_resume() {
+                    return handle.promise().result();
+                }
+            };
+
+            return Awaiter{handle_};
+        }
+
+    private:
+        handle_type handle_;
+};
+
+namespace detail {
+
+template <typename T>
+CoTask<T> CoPromise<T>::get_return_object() {
+    return CoTask<T>{std::coroutine_handle<CoPromise<T>>::from_promise(*this)};
+}
+
+inline CoTask<void> CoPromise<void>::get_return_object() {
+    return CoTask<void>{std::coroutine_handle<CoPromise<void>>::from_promise(*this)};
+}
+
+/**
+ * Eagerly resumed coroutine whose frame outlives its completion, used as a
+ * bridge between a CoTask and what waits for it. on_done is called from the
+ * final suspension point and may return a coroutine to transfer to.
+ */
+template <typename Done>
+class Bridge {
+    public:
+        struct promise_type {
+            Done* done = nullptr;
+
+            Bridge get_return_object() {
+                return Bridge{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            auto final_suspend() noexcept {
+                struct Awaiter {
+                    bool await_ready() noexcept {
+                        return false;
+                    }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                        return handle.promise().done->on_done();
+                    }
+
+                    void await_resume() noexcept {}
+                };
+
+                return Awaiter{};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() {
+                std::terminate();
+            }
+        };
+
+        explicit Bridge(std::coroutine_handle<promise_type> handle) :
+            handle_{handle} {}
+
+        Bridge(Bridge&& other) noexcept :
+            handle_{std::exchange(other.handle_, nullptr)} {}
+
+        Bridge& operator=(Bridge&&) = delete;
+
+        ~Bridge() {
+            if (handle_) {
+                handle_.destroy();
+            }
+        }
+
+        void start(Done& done) {
+            handle_.promise().done = &done;
+            handle_.resume();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+using CoResult = std::conditional_t<std::is_void<T>::value, std::monostate, T>;
+
+/**
+ * Await task and keep its result or exception.
+ */
+template <typename Done, typename T>
+Bridge<Done> bridge(CoTask<T>& task, std::optional<CoResult<T>>& result, std::exception_ptr& exception) {
+    try {
+        if constexpr (std::is_void<T>::value) {
+            co_await std::move(task);
+            result.emplace();
+        }
+        else {
+            result.emplace(co_await std::move(task));
+        }
+    }
+    catch (...) {
+        exception = std::current_exception();
+    }
+}
+
+class SyncWaitEvent {
+    public:
+        std::coroutine_handle<> on_done() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_ = true;
+            cv_.notify_one();
+
+            return std::noop_coroutine();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return done_; });
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool done_ = false;
+};
+
+/**
+ * Counts down the tasks of a when_all plus the awaiting coroutine itself,
+ * whoever arrives last resumes it.
+ */
+class WhenAllLatch {
+    public:
+        explicit WhenAllLatch(std::size_t count) :
+            count_{count + 1} {}
+
+        std::coroutine_handle<> on_done() {
+            return arrive() ? continuation_ : std::noop_coroutine();
+        }
+
+        bool arrive() {
+            return count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+        void set_continuation(std::coroutine_handle<> continuation) {
+            continuation_ = continuation;
+        }
+
+    private:
+        std::atomic<std::size_t> count_;
+        std::coroutine_handle<> continuation_;
+};
+
+template <typename T>
+CoTask<void> when_all_impl(std::vector<CoTask<T>>& tasks,
+                           std::vector<std::optional<CoResult<T>>>& results) {
+    WhenAllLatch latch(tasks.size());
+    std::vector<std::exception_ptr> exceptions(tasks.size());
+    std::vector<Bridge<WhenAllLatch>> bridges;
+
+    bridges.reserve(tasks.size());
+
+    for (std::size_t i = 0; i < tasks.size(); ++ i) {
+        bridges.push_back(bridge<WhenAllLatch>(tasks[i], results[i], exceptions[i]));
+    }
+
+    struct Awaiter {
+        WhenAllLatch& latch;
+        std::vector<Bridge<WhenAllLatch>>& bridges;
+
+        bool await_ready() noexcept {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> awaiting) {
+            latch.set_continuation(awaiting);
+
+            for (auto& bridge : bridges) {
+                bridge.start(latch);
+            }
+
+            return ! latch.arrive();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    co_await Awaiter{latch, bridges};
+
+    for (auto& exception : exceptions) {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
+
+} // namespace detail
+
+/**
+ * Start all tasks and complete once they all did, with their results in
+ * order. Each task usually begins with co_await pool.schedule() so that they
+ * run in parallel. Rethrows the exception of the first failed task.
+ */
+template <typename T>
+CoTask<std::vector<T>> when_all(std::vector<CoTask<T>> tasks) {
+    std::vector<std::optional<T>> results(tasks.size());
+
+    co_await detail::when_all_impl(tasks, results);
+
+    std::vector<T> values;
+    values.reserve(results.size());
+
+    for (auto& result : results) {
+        values.push_back(std::move(*result));
+    }
+
+    co_return values;
+}
+
+inline CoTask<void> when_all(std::vector<CoTask<void>> tasks) {
+    std::vector<std::optional<std::monostate>> results(tasks.size());
+
+    co_await detail::when_all_impl(tasks, results);
+}
+
+/**
+ * Run task from regular code, blocking the calling thread until it is done.
+ */
+template <typename T>
+T sync_wait(CoTask<T> task) {
+    std::optional<detail::CoResult<T>> result;
+    std::exception_ptr exception;
+    detail::SyncWaitEvent event;
+
+    auto bridge = detail::bridge<detail::SyncWaitEvent>(task, result, exception);
+    bridge.start(event);
+    event.wait();
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+
+    if constexpr ( ! std::is_void<T>::value) {
+        return std::move(*result);
+    }
+}
+
+} // namespace ee
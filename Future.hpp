@@ -0,0 +1,458 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace ee {
+
+namespace detail {
+
+/**
+ * Recycle objects through intrusive free lists, T needs a T* next_free member.
+ * Each thread keeps a small cache and exchanges half of it with a global list
+ * when it runs empty or full, so a producer thread fed by objects released on
+ * other threads stops allocating once warmed up.
+ */
+template <typename T>
+class FreeList {
+    public:
+        static T* acquire() {
+            Local& local = Local::get();
+
+            if ( ! local.head) {
+                Global& global = Global::get();
+                std::unique_lock<std::mutex> lock(global.mutex);
+
+                while (global.head && local.count < local_capacity / 2) {
+                    T* node = global.head;
+                    global.head = node->next_free;
+                    local.push(node);
+                }
+            }
+
+            if (local.head) {
+                return local.pop();
+            }
+
+            return new T;
+        }
+
+        static void release(T* node) {
+            Local& local = Local::get();
+
+            if (local.count == local_capacity) {
+                Global& global = Global::get();
+                std::unique_lock<std::mutex> lock(global.mutex);
+
+                while (local.count > local_capacity / 2) {
+                    T* spill = local.pop();
+                    spill->next_free = global.head;
+                    global.head = spill;
+                }
+            }
+
+            local.push(node);
+        }
+
+    private:
+        static constexpr std::size_t local_capacity = 64;
+
+        struct Local {
+            T* head = nullptr;
+            std::size_t count = 0;
+
+            static Local& get() {
+                thread_local Local local;
+                return local;
+            }
+
+            void push(T* node) {
+                node->next_free = head;
+                head = node;
+                ++ count;
+            }
+
+            T* pop() {
+                T* node = head;
+                head = node->next_free;
+                -- count;
+
+                return node;
+            }
+
+            ~Local() {
+                while (head) {
+                    delete pop();
+                }
+            }
+        };
+
+        struct Global {
+            std::mutex mutex;
+            T* head = nullptr;
+
+            static Global& get() {
+                static Global global;
+                return global;
+            }
+
+            ~Global() {
+                while (head) {
+                    T* node = head;
+                    head = node->next_free;
+                    delete node;
+                }
+            }
+        };
+};
+
+template <typename R>
+struct FutureValue {
+    std::optional<R> value;
+
+    template <typename... Args>
+    void set(Args&&... args) {
+        value.emplace(std::forward<Args>(args)...);
+    }
+
+    R take() {
+        R res = std::move(*value);
+        value.reset();
+
+        return res;
+    }
+
+    void clear() {
+        value.reset();
+    }
+};
+
+template <typename R>
+struct FutureValue<R&> {
+    R* value = nullptr;
+
+    void set(R& ref) {
+        value = &ref;
+    }
+
+    R& take() {
+        return *value;
+    }
+
+    void clear() {}
+};
+
+template <>
+struct FutureValue<void> {
+    void set() {}
+    void take() {}
+    void clear() {}
+};
+
+/**
+ * State shared by a Promise and its Future, recycled through a FreeList once
+ * both sides are gone.
+ */
+template <typename R>
+class FutureState {
+    public:
+        static FutureState* make() {
+            FutureState* state = FreeList<FutureState>::acquire();
+            state->refs_.store(2, std::memory_order_relaxed);
+            state->ready_.store(false, std::memory_order_relaxed);
+
+            return state;
+        }
+
+        void release() {
+            if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                exception_ = nullptr;
+                value_.clear();
+                FreeList<FutureState>::release(this);
+            }
+        }
+
+        template <typename... Args>
+        void set_value(Args&&... args) {
+            value_.set(std::forward<Args>(args)...);
+            signal();
+        }
+
+        void set_exception(std::exception_ptr exception) {
+            exception_ = std::move(exception);
+            signal();
+        }
+
+        bool is_ready() const {
+            return ready_.load(std::memory_order_acquire);
+        }
+
+        void wait() {
+            if (is_ready()) {
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_ = true;
+            cv_.wait(lock, [this] { return is_ready(); });
+            waiting_ = false;
+        }
+
+        template <typename Rep, typename Period>
+        bool wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+            if (is_ready()) {
+                return true;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_ = true;
+            const bool ready = cv_.wait_for(lock, timeout, [this] { return is_ready(); });
+            waiting_ = false;
+
+            return ready;
+        }
+
+        template <typename Clock, typename Duration>
+        bool wait_until(const std::chrono::time_point<Clock, Duration>& time) {
+            if (is_ready()) {
+                return true;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_ = true;
+            const bool ready = cv_.wait_until(lock, time, [this] { return is_ready(); });
+            waiting_ = false;
+
+            return ready;
+        }
+
+        R get() {
+            wait();
+
+            if (exception_) {
+                std::rethrow_exception(exception_);
+            }
+
+            return value_.take();
+        }
+
+        FutureState* next_free = nullptr;
+
+    private:
+        void signal() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.store(true, std::memory_order_release);
+
+            if (waiting_) {
+                cv_.notify_one();
+            }
+        }
+
+        std::atomic<unsigned int> refs_{0};
+        std::atomic<bool> ready_{false};
+        bool waiting_ = false;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::exception_ptr exception_;
+        FutureValue<R> value_;
+};
+
+} // namespace detail
+
+template <typename R>
+class Promise;
+
+/**
+ * Lightweight single consumer counterpart of std::future, its shared state
+ * comes from a pool instead of the heap. It has get(), wait(), wait_for(),
+ * wait_until() and valid() but no share(), code holding the result of
+ * ThreadPool::arun() as a std::future has to take an ee::Future instead.
+ */
+template <typename R>
+class Future {
+    public:
+        Future() = default;
+
+        Future(Future&& other) noexcept :
+            state_{std::exchange(other.state_, nullptr)} {}
+
+        Future& operator=(Future&& other) noexcept {
+            if (this != &other) {
+                reset();
+                state_ = std::exchange(other.state_, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~Future() {
+            reset();
+        }
+
+        bool valid() const {
+            return state_ != nullptr;
+        }
+
+        bool is_ready() const {
+            return state_->is_ready();
+        }
+
+        void wait() const {
+            state_->wait();
+        }
+
+        /**
+         * Wait for the result at most for timeout or until time, as
+         * std::future does. Never deferred, the status is ready or timeout.
+         */
+        template <typename Rep, typename Period>
+        std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+            return state_->wait_for(timeout) ? std::future_status::ready : std::future_status::timeout;
+        }
+
+        template <typename Clock, typename Duration>
+        std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& time) const {
+            return state_->wait_until(time) ? std::future_status::ready : std::future_status::timeout;
+        }
+
+        /**
+         * Wait for the result and return it, rethrow if the task threw.
+         * The future is no longer valid afterward.
+         */
+        R get() {
+            struct Reset {
+                Future& future;
+                ~Reset() { future.reset(); }
+            } reset{*this};
+
+            return state_->get();
+        }
+
+    private:
+        friend class Promise<R>;
+
+        explicit Future(detail::FutureState<R>* state) :
+            state_{state} {}
+
+        void reset() {
+            if (state_) {
+                state_->release();
+                state_ = nullptr;
+            }
+        }
+
+        detail::FutureState<R>* state_ = nullptr;
+};
+
+/**
+ * Producer side of a Future. A promise destroyed without being satisfied
+ * breaks it, get() then throws std::future_error like std::promise.
+ */
+template <typename R>
+class Promise {
+    public:
+        Promise() :
+            state_{detail::FutureState<R>::make()} {}
+
+        Promise(Promise&& other) noexcept :
+            state_{std::exchange(other.state_, nullptr)},
+            retrieved_{other.retrieved_} {}
+
+        Promise& operator=(Promise&& other) noexcept {
+            if (this != &other) {
+                abandon();
+                state_ = std::exchange(other.state_, nullptr);
+                retrieved_ = other.retrieved_;
+            }
+
+            return *this;
+        }
+
+        ~Promise() {
+            abandon();
+        }
+
+        /**
+         * Must be called once, before the promise is satisfied.
+         */
+        Future<R> get_future() {
+            retrieved_ = true;
+
+            return Future<R>{state_};
+        }
+
+        template <typename... Args>
+        void set_value(Args&&... args) {
+            state_->set_value(std::forward<Args>(args)...);
+            done();
+        }
+
+        void set_exception(std::exception_ptr exception) {
+            state_->set_exception(std::move(exception));
+            done();
+        }
+
+    private:
+        void done() {
+            // the future side reference is dropped here if it was never taken
+            if ( ! retrieved_) {
+                state_->release();
+            }
+
+            state_->release();
+            state_ = nullptr;
+        }
+
+        void abandon() {
+            if (state_ && ! retrieved_) {
+                state_->release();
+                state_->release();
+                state_ = nullptr;
+            }
+            else if (state_) {
+                set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }
+        }
+
+        detail::FutureState<R>* state_ = nullptr;
+        bool retrieved_ = false;
+};
+
+namespace detail {
+
+/**
+ * Satisfy promise with the result of fn, or with the exception it throws.
+ */
+template <typename R, typename Fn>
+void fulfill(Promise<R>& promise, Fn&& fn) {
+    try {
+        if constexpr (std::is_void<R>::value) {
+            std::forward<Fn>(fn)();
+            promise.set_value();
+        }
+        else {
+            promise.set_value(std::forward<Fn>(fn)());
+        }
+    }
+    catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+} // namespace detail
+
+} // namespace ee
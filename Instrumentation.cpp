@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <ostream>
+
+namespace ee {
+
+namespace {
+
+std::size_t bucket_of(std::uint64_t value) {
+    std::size_t bucket = 0;
+
+    while (value) {
+        value >>= 1;
+        ++ bucket;
+    }
+
+    return bucket;
+}
+
+void add(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+} // namespace
+
+double Histogram::mean() const {
+    return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+std::uint64_t Histogram::percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    const auto rank = std::min(static_cast<std::uint64_t>(q * count), count - 1);
+    std::uint64_t seen = 0;
+
+    for (std::size_t i = 0; i < bucket_count; ++ i) {
+        seen += buckets[i];
+
+        if (seen > rank) {
+            return i == 0 ? 0 : i < 64 ? std::min(max, (std::uint64_t{1} << i) - 1) : max;
+        }
+    }
+
+    return max;
+}
+
+namespace detail {
+
+void HistogramCounters::record(std::uint64_t value) {
+    add(buckets_[bucket_of(value)], 1);
+    add(count_, 1);
+    add(sum_, value);
+
+    if (value > max_.load(std::memory_order_relaxed)) {
+        max_.store(value, std::memory_order_relaxed);
+    }
+}
+
+Histogram HistogramCounters::snapshot() const {
+    Histogram histogram;
+
+    for (std::size_t i = 0; i < Histogram::bucket_count; ++ i) {
+        histogram.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+
+    histogram.count = count_.load(std::memory_order_relaxed);
+    histogram.sum = sum_.load(std::memory_order_relaxed);
+    histogram.max = max_.load(std::memory_order_relaxed);
+
+    return histogram;
+}
+
+void HistogramCounters::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+void WorkerCounters::record_task(std::uint64_t wait_ns, std::uint64_t run_ns, std::uint64_t queue_depth) {
+    add(tasks_, 1);
+    wait_ns_.record(wait_ns);
+    run_ns_.record(run_ns);
+    queue_depth_.record(queue_depth);
+}
+
+void WorkerCounters::record_idle(std::uint64_t idle_ns) {
+    add(idle_ns_, idle_ns);
+}
+
+WorkerStats WorkerCounters::snapshot() const {
+    WorkerStats stats;
+
+    stats.tasks = tasks_.load(std::memory_order_relaxed);
+    stats.idle_ns = idle_ns_.load(std::memory_order_relaxed);
+    stats.wait_ns = wait_ns_.snapshot();
+    stats.run_ns = run_ns_.snapshot();
+    stats.queue_depth = queue_depth_.snapshot();
+
+    return stats;
+}
+
+void WorkerCounters::reset() {
+    tasks_.store(0, std::memory_order_relaxed);
+    idle_ns_.store(0, std::memory_order_relaxed);
+    wait_ns_.reset();
+    run_ns_.reset();
+    queue_depth_.reset();
+}
+
+void TraceRing::resize(std::size_t capacity) {
+    events_.assign(capacity, TraceEvent{});
+    next_ = 0;
+    wrapped_ = false;
+}
+
+void TraceRing::record(const TraceEvent& event) {
+    if (events_.empty()) {
+        return;
+    }
+
+    events_[next_] = event;
+
+    if (++ next_ == events_.size()) {
+        next_ = 0;
+        wrapped_ = true;
+    }
+}
+
+void write_chrome_trace(std::ostream& out, const std::vector<const TraceRing*>& rings, std::int64_t origin) {
+    const auto us = [origin](std::int64_t ns) { return (ns - origin) / 1000.0; };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+
+    auto separate = [&out, &first] {
+        if ( ! first) {
+            out << ",";
+        }
+
+        first = false;
+    };
+
+    for (std::size_t thread_id = 0; thread_id < rings.size(); ++ thread_id) {
+        separate();
+        out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread_id
+            << ",\"args\":{\"name\":\""
+            << (thread_id + 1 < rings.size() ? "worker " : "assist ") << thread_id << "\"}}";
+
+        rings[thread_id]->for_each([&](const TraceEvent& event) {
+            separate();
+            out << "\n{\"name\":\"" << (event.idle ? "idle" : "task")
+                << "\",\"cat\":\"" << (event.idle ? "idle" : "task")
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_id
+                << ",\"ts\":" << us(event.start)
+                << ",\"dur\":" << event.duration / 1000.0;
+
+            if ( ! event.idle) {
+                out << ",\"args\":{\"wait_us\":" << event.wait / 1000.0 << "}";
+            }
+
+            out << "}";
+        });
+    }
+
+    out << "\n]}\n";
+}
+
+} // namespace detail
+
+} // namespace ee
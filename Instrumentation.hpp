@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace ee {
+
+/**
+ * Distribution of values in power of two buckets, bucket 0 counting zeros and
+ * bucket i values in [2^(i-1), 2^i).
+ */
+struct Histogram {
+    static constexpr std::size_t bucket_count = 65;
+
+    std::array<std::uint64_t, bucket_count> buckets{};
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    double mean() const;
+
+    /**
+     * Upper bound of the bucket holding the q quantile, q in [0, 1].
+     */
+    std::uint64_t percentile(double q) const;
+};
+
+/**
+ * What a thread_id did since the last reset. Durations are in nanoseconds,
+ * wait_ns being the time from submission to start of a task and queue_depth
+ * the number of queued tasks seen when starting one.
+ */
+struct WorkerStats {
+    std::uint64_t tasks = 0;
+    std::uint64_t idle_ns = 0;
+    Histogram wait_ns;
+    Histogram run_ns;
+    Histogram queue_depth;
+};
+
+namespace detail {
+
+/**
+ * Counters have a single writer, the thread owning them, updates are relaxed
+ * loads and stores so that readers see consistent values without paying for
+ * atomic read-modify-writes.
+ */
+class HistogramCounters {
+    public:
+        void record(std::uint64_t);
+        Histogram snapshot() const;
+        void reset();
+
+    private:
+        std::array<std::atomic<std::uint64_t>, Histogram::bucket_count> buckets_{};
+        std::atomic<std::uint64_t> count_{0};
+        std::atomic<std::uint64_t> sum_{0};
+        std::atomic<std::uint64_t> max_{0};
+};
+
+/**
+ * Counters of one thread_id of a pool. Each thread_id has a single writer at
+ * a time: a worker id is written by its worker, the worker_count() id by
+ * whichever outside thread holds it to run a task, under the pool's assist
+ * lock. Blocking lane threads are not recorded.
+ */
+class WorkerCounters {
+    public:
+        void record_task(std::uint64_t wait_ns, std::uint64_t run_ns, std::uint64_t queue_depth);
+        void record_idle(std::uint64_t idle_ns);
+        WorkerStats snapshot() const;
+        void reset();
+
+    private:
+        std::atomic<std::uint64_t> tasks_{0};
+        std::atomic<std::uint64_t> idle_ns_{0};
+        HistogramCounters wait_ns_;
+        HistogramCounters run_ns_;
+        HistogramCounters queue_depth_;
+};
+
+/**
+ * Span of time a thread spent running a task or idling, in nanoseconds.
+ */
+struct TraceEvent {
+    std::int64_t start;
+    std::int64_t duration;
+    std::int64_t wait;
+    bool idle;
+};
+
+/**
+ * Fixed size ring of the last events of a thread. Like WorkerCounters, it has
+ * a single writer at a time, the one thread using its thread_id.
+ */
+class TraceRing {
+    public:
+        void resize(std::size_t);
+        void record(const TraceEvent&);
+
+        template <typename Fn>
+        void for_each(Fn&& fn) const {
+            const std::size_t first = wrapped_ ? next_ : 0;
+            const std::size_t count = wrapped_ ? events_.size() : next_;
+
+            for (std::size_t i = 0; i < count; ++ i) {
+                fn(events_[(first + i) % events_.size()]);
+            }
+        }
+
+    private:
+        std::vector<TraceEvent> events_;
+        std::size_t next_ = 0;
+        bool wrapped_ = false;
+};
+
+/**
+ * Write rings as Chrome trace event JSON, loadable in chrome://tracing or
+ * Perfetto. Ring i is thread_id i, the last one being the assisting thread.
+ * Timestamps are relative to origin.
+ */
+void write_chrome_trace(std::ostream&, const std::vector<const TraceRing*>&, std::int64_t origin);
+
+} // namespace detail
+
+} // namespace ee
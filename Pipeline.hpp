@@ -0,0 +1,309 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace ee {
+
+/**
+ * How a pipeline stage runs.
+ *  - Parallel: on any number of items at once.
+ *  - SerialInOrder: on one item at a time, in the order the source made them.
+ *  - SerialOutOfOrder: on one item at a time, in any order.
+ */
+enum class StageMode {
+    Parallel,
+    SerialInOrder,
+    SerialOutOfOrder
+};
+
+/**
+ * Given to a pipeline source, stop() tells it made its last item, the value
+ * returned by the call stopping being ignored.
+ */
+class FlowControl {
+    public:
+        void stop() {
+            stopped_ = true;
+        }
+
+        bool stopped() const {
+            return stopped_;
+        }
+
+    private:
+        bool stopped_ = false;
+};
+
+template <typename Fn>
+struct Stage {
+    StageMode mode;
+    Fn fn;
+};
+
+template <typename Fn>
+Stage<std::decay_t<Fn>> make_stage(StageMode mode, Fn&& fn) {
+    return {mode, std::forward<Fn>(fn)};
+}
+
+namespace detail {
+
+/**
+ * Types flowing between stages, the source's output first, the last stage's
+ * output being dropped.
+ */
+template <typename In, typename... Fns>
+struct StageTypes {
+    using type = std::tuple<>;
+};
+
+template <typename In, typename Fn, typename Next, typename... Fns>
+struct StageTypes<In, Fn, Next, Fns...> {
+    using out = std::invoke_result_t<Fn&, std::size_t, In>;
+    using type = decltype(std::tuple_cat(std::declval<std::tuple<out>>(),
+                                         std::declval<typename StageTypes<out, Next, Fns...>::type>()));
+};
+
+template <typename Tuple>
+struct Payload;
+
+template <typename... Ts>
+struct Payload<std::tuple<Ts...>> {
+    // index k + 1 holds the input of stage k + 1
+    using type = std::variant<std::monostate, Ts...>;
+};
+
+/**
+ * Items travel on a fixed set of tokens. A token goes through the stages on
+ * the thread that runs it until a serial stage is busy, or not ready for it
+ * when in order, where it is parked. The thread leaving a serial stage hands
+ * the stage to a parked token, submitted as a task of its own, and goes on
+ * with its own token. After the last stage a token goes back to the source
+ * for a new item.
+ */
+template <typename Source, typename... Fns>
+class Pipeline {
+    public:
+        Pipeline(ThreadPool& pool, std::size_t max_tokens, Stage<Source>& source, Stage<Fns>&... stages) :
+            group_{pool},
+            stages_{source.fn, stages.fn...},
+            tokens_(std::max<std::size_t>(max_tokens, 1)) {
+            const std::array<StageMode, count> modes{source.mode, stages.mode...};
+
+            for (std::size_t stage = 0; stage < count; ++ stage) {
+                states_[stage].mode = modes[stage];
+                states_[stage].parked.reserve(tokens_.size());
+            }
+
+            // the source is serial, items being numbered in the order it makes them
+            if (states_[0].mode == StageMode::Parallel) {
+                states_[0].mode = StageMode::SerialInOrder;
+            }
+        }
+
+        void run() {
+            for (Token& token : tokens_) {
+                group_.run([this, token = &token](std::size_t thread_id) {
+                    drive(thread_id, token, 0, false);
+                });
+            }
+
+            group_.wait();
+        }
+
+    private:
+        static constexpr std::size_t count = sizeof...(Fns) + 1;
+
+        using Item = std::invoke_result_t<Source&, std::size_t, FlowControl&>;
+        using Types = decltype(std::tuple_cat(std::declval<std::tuple<Item>>(),
+                                              std::declval<typename StageTypes<Item, Fns...>::type>()));
+
+        struct Token {
+            std::size_t sequence = 0;
+            typename Payload<Types>::type value;
+        };
+
+        struct State {
+            StageMode mode = StageMode::Parallel;
+            std::mutex mutex;
+            bool busy = false;
+            std::size_t next = 0;
+            std::vector<Token*> parked;
+        };
+
+        /**
+         * Run token from stage on, stage being entered already if serial.
+         */
+        void drive(std::size_t thread_id, Token* token, std::size_t stage, bool entered) {
+            try {
+                while (true) {
+                    for (; stage < count; ++ stage, entered = false) {
+                        State& state = states_[stage];
+                        const bool serial = state.mode != StageMode::Parallel;
+
+                        if (serial && ! entered && ! enter(stage, token)) {
+                            return;
+                        }
+
+                        const bool produced = run_stage(thread_id, stage, *token);
+
+                        if (serial) {
+                            if (Token* next = leave(stage)) {
+                                group_.run([this, next, stage](std::size_t thread_id) {
+                                    drive(thread_id, next, stage, true);
+                                });
+                            }
+                        }
+
+                        if ( ! produced) {
+                            return;
+                        }
+                    }
+
+                    stage = 0;
+                }
+            }
+            catch (...) {
+                // no new item, tokens parked behind the failed one stay there
+                stopped_ = true;
+                throw;
+            }
+        }
+
+        /**
+         * Whether token may run serial stage now, parking it otherwise.
+         */
+        bool enter(std::size_t stage, Token* token) {
+            State& state = states_[stage];
+            std::unique_lock<std::mutex> lock(state.mutex);
+
+            if (stage == 0 && stopped_) {
+                return false;
+            }
+
+            if (state.busy || (state.mode == StageMode::SerialInOrder && stage > 0 && token->sequence != state.next)) {
+                state.parked.push_back(token);
+                return false;
+            }
+
+            state.busy = true;
+
+            return true;
+        }
+
+        /**
+         * Release serial stage, return a parked token that may run it next,
+         * the stage being kept busy for it.
+         */
+        Token* leave(std::size_t stage) {
+            State& state = states_[stage];
+            std::unique_lock<std::mutex> lock(state.mutex);
+
+            ++ state.next;
+
+            if (stage == 0 && stopped_) {
+                // tokens waiting for an item get none
+                state.parked.clear();
+            }
+
+            for (auto it = state.parked.begin(); it != state.parked.end(); ++ it) {
+                if (stage == 0 || state.mode != StageMode::SerialInOrder || (*it)->sequence == state.next) {
+                    Token* token = *it;
+                    state.parked.erase(it);
+
+                    return token;
+                }
+            }
+
+            state.busy = false;
+
+            return nullptr;
+        }
+
+        /**
+         * Run one stage on token, false when the source made no item.
+         */
+        bool run_stage(std::size_t thread_id, std::size_t stage, Token& token) {
+            return run_stage(thread_id, stage, token, std::make_index_sequence<count>{});
+        }
+
+        template <std::size_t... Is>
+        bool run_stage(std::size_t thread_id, std::size_t stage, Token& token, std::index_sequence<Is...>) {
+            bool produced = true;
+
+            ((stage == Is ? (produced = run_stage<Is>(thread_id, token), true) : false) || ...);
+
+            return produced;
+        }
+
+        template <std::size_t I>
+        bool run_stage(std::size_t thread_id, Token& token) {
+            auto& fn = std::get<I>(stages_);
+
+            if constexpr (I == 0) {
+                FlowControl flow;
+
+                auto value = fn(thread_id, flow);
+
+                if (flow.stopped() || stopped_) {
+                    stopped_ = true;
+                    return false;
+                }
+
+                // the source is serial, states_[0].next numbers the items
+                token.sequence = states_[0].next;
+                token.value.template emplace<1>(std::move(value));
+            }
+            else if constexpr (I + 1 == count) {
+                fn(thread_id, std::move(std::get<I>(token.value)));
+                token.value.template emplace<0>();
+            }
+            else {
+                token.value.template emplace<I + 1>(fn(thread_id, std::move(std::get<I>(token.value))));
+            }
+
+            return true;
+        }
+
+        TaskGroup group_;
+        std::tuple<Source&, Fns&...> stages_;
+        std::array<State, count> states_;
+        std::vector<Token> tokens_;
+        std::atomic<bool> stopped_{false};
+};
+
+} // namespace detail
+
+/**
+ * Run items made by source through stages on pool, with at most max_tokens
+ * items in flight, and return once all are through. The source is called as
+ * fn(thread_id, flow) and runs serially, each stage fn(thread_id, item)
+ * receiving what the previous one returned, the last one's result being
+ * dropped. Serial stages never block a thread, items waiting for one are
+ * parked until it is free. Rethrow the first exception a stage threw, no new
+ * item being made once one did.
+ */
+template <typename Source, typename... Fns>
+void parallel_pipeline(ThreadPool& pool, std::size_t max_tokens, Stage<Source> source, Stage<Fns>... stages) {
+    detail::Pipeline<Source, Fns...> pipeline(pool, max_tokens, source, stages...);
+
+    pipeline.run();
+}
+
+} // namespace ee
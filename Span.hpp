@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#include "templates.hpp"
+
+namespace ee {
+
+/**
+ * View of count contiguous T, a C++17 stand-in for std::span. Built from a
+ * pointer and a count or from any container with data() and size().
+ */
+template <typename T>
+class Span {
+    public:
+        using element_type = T;
+        using value_type = std::remove_cv_t<T>;
+        using iterator = T*;
+
+        constexpr Span() = default;
+
+        constexpr Span(T* data, std::size_t size) :
+            data_{data},
+            size_{size} {}
+
+        template <typename Container, typename = tutil::eif<
+        std::is_convertible_v<decltype(std::declval<Container&>().data()), T*> && ! std::is_same_v<std::decay_t<Container>, Span>
+        >>
+        constexpr Span(Container& container) :
+            Span(container.data(), container.size()) {}
+
+        template <typename U, typename = tutil::eif<std::is_convertible_v<U*, T*>>>
+        constexpr Span(Span<U> other) :
+            Span(other.data(), other.size()) {}
+
+        constexpr T* data() const {
+            return data_;
+        }
+
+        constexpr std::size_t size() const {
+            return size_;
+        }
+
+        constexpr bool empty() const {
+            return size_ == 0;
+        }
+
+        constexpr T& operator[](std::size_t i) const {
+            return data_[i];
+        }
+
+        constexpr iterator begin() const {
+            return data_;
+        }
+
+        constexpr iterator end() const {
+            return data_ + size_;
+        }
+
+        constexpr Span subspan(std::size_t offset, std::size_t count) const {
+            return {data_ + offset, count};
+        }
+
+    private:
+        T* data_ = nullptr;
+        std::size_t size_ = 0;
+};
+
+} // namespace ee
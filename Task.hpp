@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "templates.hpp"
+
+namespace ee {
+
+using tutil::eif;
+
+/**
+ * Move only type erased void(std::size_t) callable.
+ * Callables up to inline_size bytes with a noexcept move constructor are
+ * stored in place, bigger ones fall back to the heap.
+ */
+class Task {
+    public:
+        static constexpr std::size_t inline_size = 48;
+
+        Task() = default;
+
+        Task(std::nullptr_t) {}
+
+        template <typename Fn, typename = eif< ! std::is_same<std::decay_t<Fn>, Task>::value>>
+        Task(Fn&& fn) {
+            using F = std::decay_t<Fn>;
+
+            if constexpr (is_inline<F>) {
+                new (storage_) F(std::forward<Fn>(fn));
+            }
+            else {
+                new (storage_) F*(new F(std::forward<Fn>(fn)));
+            }
+
+            vtable_ = &vtable_for<F>;
+        }
+
+        Task(Task&& other) noexcept {
+            move_from(other);
+        }
+
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                reset();
+                move_from(other);
+            }
+
+            return *this;
+        }
+
+        Task& operator=(std::nullptr_t) noexcept {
+            reset();
+
+            return *this;
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task() {
+            reset();
+        }
+
+        explicit operator bool() const noexcept {
+            return vtable_ != nullptr;
+        }
+
+        void operator()(std::size_t thread_id) {
+            vtable_->invoke(storage_, thread_id);
+        }
+
+    private:
+        struct VTable {
+            void (*invoke)(void*, std::size_t);
+            void (*move)(void*, void*) noexcept;
+            void (*destroy)(void*) noexcept;
+        };
+
+        template <typename F>
+        static constexpr bool is_inline =
+            sizeof(F) <= inline_size &&
+            alignof(F) <= alignof(std::max_align_t) &&
+            std::is_nothrow_move_constructible<F>::value;
+
+        template <typename F>
+        static F& target(void* storage) noexcept {
+            if constexpr (is_inline<F>) {
+                return *std::launder(reinterpret_cast<F*>(storage));
+            }
+            else {
+                return **std::launder(reinterpret_cast<F**>(storage));
+            }
+        }
+
+        template <typename F>
+        static constexpr VTable vtable_for = {
+            [](void* storage, std::size_t thread_id) {
+                target<F>(storage)(thread_id);
+            },
+            [](void* dst, void* src) noexcept {
+                if constexpr (is_inline<F>) {
+                    new (dst) F(std::move(target<F>(src)));
+                    target<F>(src).~F();
+                }
+                else {
+                    new (dst) F*(&target<F>(src));
+                }
+            },
+            [](void* storage) noexcept {
+                if constexpr (is_inline<F>) {
+                    target<F>(storage).~F();
+                }
+                else {
+                    delete &target<F>(storage);
+                }
+            }
+        };
+
+        void move_from(Task& other) noexcept {
+            if (other.vtable_) {
+                other.vtable_->move(storage_, other.storage_);
+                vtable_ = other.vtable_;
+                other.vtable_ = nullptr;
+            }
+        }
+
+        void reset() noexcept {
+            if (vtable_) {
+                vtable_->destroy(storage_);
+                vtable_ = nullptr;
+            }
+        }
+
+        const VTable* vtable_ = nullptr;
+        alignas(std::max_align_t) unsigned char storage_[inline_size];
+};
+
+} // namespace ee
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#include "TaskGraph.hpp"
+
+#include <stdexcept>
+
+namespace ee {
+
+void TaskGraph::precede(Node before, Node after) {
+    nodes_[before].successors.push_back(after);
+    ++ nodes_[after].predecessors;
+    prepared_ = false;
+}
+
+void TaskGraph::run(ThreadPool& pool) {
+    prepare();
+
+    for (Node node = 0; node < nodes_.size(); ++ node) {
+        remaining_[node].store(nodes_[node].predecessors, std::memory_order_relaxed);
+    }
+
+    TaskGroup group(pool);
+
+    group.run_n(roots_.size(), [this, &group](std::size_t thread_id, std::size_t i) {
+        execute(group, roots_[i], thread_id);
+    });
+
+    group.wait();
+}
+
+std::size_t TaskGraph::node_count() const {
+    return nodes_.size();
+}
+
+void TaskGraph::clear() {
+    nodes_.clear();
+    roots_.clear();
+    prepared_ = false;
+}
+
+/**
+ * Find roots, check for cycles and size the counters, once per change.
+ */
+void TaskGraph::prepare() {
+    if (prepared_) {
+        return;
+    }
+
+    roots_.clear();
+
+    std::vector<std::size_t> remaining(nodes_.size());
+    std::vector<Node> ready;
+
+    for (Node node = 0; node < nodes_.size(); ++ node) {
+        remaining[node] = nodes_[node].predecessors;
+
+        if (remaining[node] == 0) {
+            roots_.push_back(node);
+            ready.push_back(node);
+        }
+    }
+
+    // Kahn's algorithm, every node is reached only if there is no cycle
+    std::size_t reached = 0;
+
+    while ( ! ready.empty()) {
+        const Node node = ready.back();
+        ready.pop_back();
+        ++ reached;
+
+        for (Node successor : nodes_[node].successors) {
+            if (-- remaining[successor] == 0) {
+                ready.push_back(successor);
+            }
+        }
+    }
+
+    if (reached != nodes_.size()) {
+        throw std::logic_error("TaskGraph has a cycle");
+    }
+
+    remaining_ = std::make_unique<std::atomic<std::size_t>[]>(nodes_.size());
+    prepared_ = true;
+}
+
+void TaskGraph::execute(TaskGroup& group, Node node, std::size_t thread_id) {
+    constexpr Node none = static_cast<Node>(-1);
+
+    while (node != none) {
+        nodes_[node].task(thread_id);
+
+        // submit all newly ready successors but one, run that one here
+        Node next = none;
+
+        for (Node successor : nodes_[node].successors) {
+            if (remaining_[successor].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                continue;
+            }
+
+            if (next != none) {
+                group.run([this, &group, next](std::size_t tid) {
+                    execute(group, next, tid);
+                });
+            }
+
+            next = successor;
+        }
+
+        node = next;
+    }
+}
+
+} // namespace ee
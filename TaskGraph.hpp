@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace ee {
+
+/**
+ * Directed acyclic graph of tasks, declared once and run as many times as
+ * needed. A node is submitted as soon as all its predecessors are done, the
+ * thread completing a node runs one of the nodes it made ready itself.
+ * Running the graph again reuses everything allocated by the first run.
+ * A node throwing skips its successors, run() then rethrows the exception.
+ */
+class TaskGraph {
+    public:
+        using Node = std::size_t;
+
+        /**
+         * Add a node calling fn(thread_id) at each run.
+         */
+        template <typename Fn>
+        Node add(Fn&& fn);
+
+        /**
+         * Make after wait for before.
+         */
+        void precede(Node before, Node after);
+
+        /**
+         * Run all nodes on pool, the calling thread helping, and return once
+         * they are done. Throws std::logic_error if the graph has a cycle.
+         * A graph must not be run concurrently with itself.
+         */
+        void run(ThreadPool&);
+
+        std::size_t node_count() const;
+        void clear();
+
+    private:
+        struct NodeData {
+            Task task;
+            std::vector<Node> successors;
+            std::size_t predecessors = 0;
+        };
+
+        void prepare();
+        void execute(TaskGroup&, Node, std::size_t);
+
+        std::vector<NodeData> nodes_;
+        std::vector<Node> roots_;
+        std::unique_ptr<std::atomic<std::size_t>[]> remaining_;
+        bool prepared_ = false;
+};
+
+template <typename Fn>
+TaskGraph::Node TaskGraph::add(Fn&& fn) {
+    nodes_.push_back({Task(std::forward<Fn>(fn)), {}, 0});
+    prepared_ = false;
+
+    return nodes_.size() - 1;
+}
+
+} // namespace ee
@@ -7,9 +7,250 @@
 
 #include "ThreadPool.hpp"
 
+#include <array>
+#include <cassert>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
 namespace ee {
 
-ThreadPool::ThreadPool(std::size_t nt) {
+namespace {
+
+// pool and thread_id of the worker running on the current thread, if any
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local std::size_t current_thread_id = 0;
+
+std::chrono::nanoseconds::rep now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Count a submission in flight while it lives, so that join() waits for those
+ * that got past its check to be queued.
+ */
+class Submission {
+    public:
+        explicit Submission(std::atomic<std::size_t>& count) :
+            count_{count} {
+            ++ count_;
+        }
+
+        ~Submission() {
+            -- count_;
+        }
+
+        Submission(const Submission&) = delete;
+        Submission& operator=(const Submission&) = delete;
+
+    private:
+        std::atomic<std::size_t>& count_;
+};
+
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#if defined(__linux__)
+
+/**
+ * Parse a sysfs cpu list like "0-3,8,10-11".
+ */
+std::vector<unsigned int> parse_cpu_list(const std::string& list) {
+    std::vector<unsigned int> cpus;
+    std::size_t pos = 0;
+
+    while (pos < list.size()) {
+        std::size_t end = list.find(',', pos);
+
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+
+        const std::string range = list.substr(pos, end - pos);
+        const std::size_t dash = range.find('-');
+
+        try {
+            const unsigned int first = std::stoul(range.substr(0, dash));
+            const unsigned int last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+
+            for (unsigned int cpu = first; cpu <= last; ++ cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (...) {
+            // blank or malformed entry
+        }
+
+        pos = end + 1;
+    }
+
+    return cpus;
+}
+
+/**
+ * Allowed cores of the process grouped by NUMA node.
+ */
+std::vector<std::vector<unsigned int>> read_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return {};
+    }
+
+    std::vector<std::vector<unsigned int>> nodes;
+    std::vector<bool> seen(CPU_SETSIZE, false);
+
+    for (std::size_t node = 0; ; ++ node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+
+        if ( ! file) {
+            break;
+        }
+
+        std::string list;
+        std::getline(file, list);
+
+        nodes.emplace_back();
+
+        for (unsigned int cpu : parse_cpu_list(list)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                nodes.back().push_back(cpu);
+                seen[cpu] = true;
+            }
+        }
+    }
+
+    // cores missing from sysfs end up on a node of their own
+    std::vector<unsigned int> rest;
+
+    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++ cpu) {
+        if (CPU_ISSET(cpu, &allowed) && ! seen[cpu]) {
+            rest.push_back(cpu);
+        }
+    }
+
+    if ( ! rest.empty()) {
+        nodes.push_back(std::move(rest));
+    }
+
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                               [](const auto& cpus) { return cpus.empty(); }),
+                nodes.end());
+
+    return nodes;
+}
+
+void pin_current_thread(unsigned int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+#else
+
+std::vector<std::vector<unsigned int>> read_topology() {
+    return {};
+}
+
+void pin_current_thread(unsigned int) {}
+
+#endif
+
+} // namespace
+
+/**
+ * Hold worker_count() for the calling thread, not a worker, while it lives.
+ * A thread already holding it for the same pool, running a task it took,
+ * keeps it for nested calls. Without blocking, it may not be held.
+ */
+struct ThreadPool::AssistScope {
+    AssistScope(ThreadPool& pool, bool block) :
+        pool{pool},
+        lock{pool.mutex_assist_, std::defer_lock},
+        outer{assist_scopes_} {
+        for (AssistScope* scope = outer; scope && ! held; scope = scope->outer) {
+            held = &scope->pool == &pool && scope->held;
+        }
+
+        if ( ! held) {
+            held = block ? (lock.lock(), true) : lock.try_lock();
+        }
+
+        assist_scopes_ = this;
+    }
+
+    ~AssistScope() {
+        assist_scopes_ = outer;
+    }
+
+    AssistScope(const AssistScope&) = delete;
+    AssistScope& operator=(const AssistScope&) = delete;
+
+    ThreadPool& pool;
+    std::unique_lock<std::mutex> lock;
+    AssistScope* outer;
+    bool held = false;
+};
+
+thread_local ThreadPool::AssistScope* ThreadPool::assist_scopes_ = nullptr;
+
+ThreadPool::ThreadPool(std::size_t nt, Placement placement) :
+    ThreadPool(nt, placement, QueuePolicy{}) {}
+
+ThreadPool::ThreadPool(std::size_t nt, Placement placement, QueuePolicy queue_policy) :
+    placement_{placement},
+    overflow_{queue_policy.overflow} {
+    if (queue_policy.capacity > 0) {
+        for (auto& ring : rings_) {
+            ring = std::make_unique<BoundedQueue<Entry>>(queue_policy.capacity);
+        }
+    }
+
+    if (placement_ != Placement::None) {
+        const auto nodes = read_topology();
+
+        for (std::size_t i = 0; placement_ == Placement::Compact && i < nodes.size(); ++ i) {
+            for (unsigned int cpu : nodes[i]) {
+                slots_.push_back({cpu, i});
+            }
+        }
+
+        for (std::size_t rank = 0; placement_ == Placement::Scatter; ++ rank) {
+            const std::size_t before = slots_.size();
+
+            for (std::size_t i = 0; i < nodes.size(); ++ i) {
+                if (rank < nodes[i].size()) {
+                    slots_.push_back({nodes[i][rank], i});
+                }
+            }
+
+            if (slots_.size() == before) {
+                break;
+            }
+        }
+
+        node_count_ = std::max<std::size_t>(nodes.size(), 1);
+    }
+
+    publish_queues(0);
     spawn(nt);
 }
 
@@ -18,94 +259,1469 @@ ThreadPool::~ThreadPool() {
 }
 
 void ThreadPool::spawn(std::size_t nt) {
+    // worker_count() changes hands
+    AssistScope assist(*this, true);
+    std::unique_lock<std::mutex> lock(mutex_workers_);
+
+    publish_queues(workers_.size() + nt);
+
     for (size_t i = 0; i < nt; ++ i) {
-        const std::size_t thread_id = workers_.size();
+        workers_.emplace_back();
+        start_worker(workers_.size() - 1);
+    }
 
-        workers_.emplace_back([this, thread_id] {
-            while ( ! join_) {
-                std::function<void(std::size_t)> f;
+    worker_count_.store(workers_.size());
+}
 
-                {
-                    std::unique_lock<std::mutex> lock(mutex_wakeup_);
+/**
+ * Start the thread of the given worker slot, mutex_workers_ must be held.
+ */
+void ThreadPool::start_worker(std::size_t thread_id) {
+    queues_[thread_id]->retired = false;
+    ++ active_;
 
-                    wakeup_.wait(
-                        lock,
-                        [this] { return join_ || ! queue_.empty(); });
+    workers_[thread_id] = std::thread([this, thread_id] {
+        current_pool = this;
+        current_thread_id = thread_id;
 
-                    if (join_ && queue_.empty()) {
-                        return;
-                    }
+        if ( ! slots_.empty()) {
+            pin_current_thread(slots_[thread_id % slots_.size()].cpu);
+        }
+
+        Entry entry;
 
-                    ++ busy_;
+        while (true) {
+            if (pop(thread_id, entry)) {
+                if (grow_after_.load(std::memory_order_relaxed) > 0) {
+                    // only write the shared stamp when it gets noticeably old
+                    const auto now = now_ns();
 
-                    f = std::move(queue_.front());
-                    queue_.pop();
+                    if (now - last_start_.load(std::memory_order_relaxed) > grow_after_ / 4) {
+                        last_start_.store(now, std::memory_order_relaxed);
+                    }
                 }
 
-                f(thread_id);
+                execute(thread_id, entry);
 
-                {
-                    std::unique_lock<std::mutex> lock(mutex_task_completed_);
+                // tasks left behind a long one may call for more workers
+                if (elastic_.load(std::memory_order_relaxed) && pending() > 0) {
+                    grow();
+                }
 
-                    -- busy_;
+                continue;
+            }
 
-                    task_completed_.notify_all();
-                }
+            if ( ! idle(thread_id)) {
+                return;
             }
-        });
-    }
+        }
+    });
 }
 
 void ThreadPool::assist() {
-    const std::size_t thread_id = workers_.size();
+    while (help(true) == Help::Ran) {}
+}
+
+/**
+ * Run one queued task, as its own thread_id from a worker, as worker_count()
+ * from any other thread. Busy when another thread holds worker_count() and
+ * block is false.
+ */
+ThreadPool::Help ThreadPool::help(bool block) {
+    Entry entry;
 
-    while (true) {
-        std::function<void(std::size_t)> f;
+    if (current_pool == this) {
+        if ( ! pop(current_thread_id, entry)) {
+            return Help::Empty;
+        }
 
-        {
-            std::unique_lock<std::mutex> lock(mutex_wakeup_);
+        execute(current_thread_id, entry);
 
-            if (queue_.empty()) {
-                return;
+        return Help::Ran;
+    }
+
+    AssistScope assist(*this, block);
+
+    if ( ! assist.held) {
+        return Help::Busy;
+    }
+
+    const std::size_t thread_id = worker_count();
+
+    if ( ! pop(thread_id, entry)) {
+        return Help::Empty;
+    }
+
+    execute(thread_id, entry);
+
+    return Help::Ran;
+}
+
+ThreadPool::TimerId ThreadPool::add_timer(Clock::time_point time, Clock::duration period, Task task) {
+    std::unique_lock<std::mutex> lock(mutex_timers_);
+
+    if (timer_stop_) {
+        return 0;
+    }
+
+    std::uint32_t slot;
+
+    if (free_timers_.empty()) {
+        slot = static_cast<std::uint32_t>(timers_.size());
+        timers_.emplace_back();
+    }
+    else {
+        slot = free_timers_.back();
+        free_timers_.pop_back();
+    }
+
+    TimerSlot& timer = timers_[slot];
+
+    timer.task = std::make_shared<TimerTask>();
+    timer.task->task = std::move(task);
+    timer.period = period;
+
+    timer_heap_.push_back({time, slot, timer.generation});
+    std::push_heap(timer_heap_.begin(), timer_heap_.end(), std::greater<>{});
+
+    if ( ! timer_thread_.joinable()) {
+        start_timer_thread();
+    }
+    else if (timer_heap_.front().slot == slot) {
+        // the timer thread sleeps until a later time
+        timer_wakeup_.notify_one();
+    }
+
+    return (static_cast<TimerId>(timer.generation) << 32) | slot;
+}
+
+bool ThreadPool::cancel(TimerId id) {
+    const auto slot = static_cast<std::uint32_t>(id);
+    const auto generation = static_cast<std::uint32_t>(id >> 32);
+
+    // the callable is destroyed once the lock is released
+    std::shared_ptr<TimerTask> task;
+
+    std::unique_lock<std::mutex> lock(mutex_timers_);
+
+    if (slot >= timers_.size() || timers_[slot].generation != generation) {
+        return false;
+    }
+
+    task = release_timer(slot);
+
+    return true;
+}
+
+/**
+ * Free a timer slot, its heap entries going stale. mutex_timers_ must be held.
+ */
+std::shared_ptr<ThreadPool::TimerTask> ThreadPool::release_timer(std::uint32_t slot) {
+    TimerSlot& timer = timers_[slot];
+
+    // 0 would make the id of slot 0 look like a failure
+    if (++ timer.generation == 0) {
+        timer.generation = 1;
+    }
+
+    free_timers_.push_back(slot);
+
+    return std::move(timer.task);
+}
+
+/**
+ * Start the timer thread unless running. mutex_timers_ must be held.
+ */
+void ThreadPool::start_timer_thread() {
+    if ( ! timer_thread_.joinable()) {
+        timer_thread_ = std::thread([this] { run_timers(); });
+    }
+}
+
+/**
+ * Timer thread, queuing timers as they come due and, while grow_watch_ is
+ * set, checking every grow_after / 2 whether queued tasks call for a worker.
+ */
+void ThreadPool::run_timers() {
+    // held by a queued run, the timer may fire again once it ran or was
+    // dropped by join(Discard)
+    struct Run {
+        explicit Run(std::shared_ptr<TimerTask> task) :
+            task{std::move(task)} {}
+
+        Run(Run&&) noexcept = default;
+
+        ~Run() {
+            if (task) {
+                task->running = false;
+            }
+        }
+
+        std::shared_ptr<TimerTask> task;
+    };
+
+    std::unique_lock<std::mutex> lock(mutex_timers_);
+
+    Clock::time_point grow_check = Clock::now();
+
+    while ( ! timer_stop_) {
+        const auto now = Clock::now();
+
+        if (grow_watch_ && now >= grow_check) {
+            lock.unlock();
+
+            if ( ! grow_due(now_ns())) {
+                grow_watch_ = false;
+
+                // pairs with grow(), a submitter either sees grow_watch_
+                // cleared or its task is seen here
+                if (pending() > 0 && active_ < worker_count()) {
+                    grow_watch_ = true;
+                }
             }
 
-            ++busy_;
+            const auto grow_after = std::chrono::nanoseconds(grow_after_.load(std::memory_order_relaxed));
 
-            f = std::move(queue_.front());
-            queue_.pop();
+            grow_check = now + std::chrono::duration_cast<Clock::duration>(grow_after / 2);
+
+            lock.lock();
+            continue;
         }
 
-        f(thread_id);
+        if (timer_heap_.empty()) {
+            if (grow_watch_) {
+                timer_wakeup_.wait_until(lock, grow_check);
+            }
+            else {
+                timer_wakeup_.wait(lock);
+            }
 
-        {
-            std::unique_lock<std::mutex> lock(mutex_task_completed_);
-            --busy_;
-            task_completed_.notify_all();
+            continue;
+        }
+
+        const TimerDue due = timer_heap_.front();
+
+        if (now < due.time) {
+            timer_wakeup_.wait_until(lock, grow_watch_ ? std::min(due.time, grow_check) : due.time);
+            continue;
+        }
+
+        std::pop_heap(timer_heap_.begin(), timer_heap_.end(), std::greater<>{});
+        timer_heap_.pop_back();
+
+        TimerSlot& timer = timers_[due.slot];
+
+        if (timer.generation != due.generation) {
+            continue;
         }
+
+        std::shared_ptr<TimerTask> task;
+
+        if (timer.period > Clock::duration::zero()) {
+            task = timer.task;
+
+            // fixed rate, unless too late for it
+            Clock::time_point next = due.time + timer.period;
+
+            if (next <= now) {
+                next = now + timer.period;
+            }
+
+            timer_heap_.push_back({next, due.slot, due.generation});
+            std::push_heap(timer_heap_.begin(), timer_heap_.end(), std::greater<>{});
+        }
+        else {
+            task = release_timer(due.slot);
+        }
+
+        lock.unlock();
+
+        if ( ! task->running.exchange(true)) {
+            push([run = Run{std::move(task)}](std::size_t thread_id) {
+                try {
+                    run.task->task(thread_id);
+                }
+                catch (...) {
+                    // nothing waits for a timer run
+                }
+            });
+        }
+
+        task.reset();
+
+        lock.lock();
+    }
+}
+
+/**
+ * Stop the timer thread and drop all timers, ids given so far staying
+ * invalid.
+ */
+void ThreadPool::stop_timers() {
+    std::vector<std::shared_ptr<TimerTask>> tasks;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_timers_);
+        timer_stop_ = true;
+    }
+
+    timer_wakeup_.notify_all();
+
+    if (timer_thread_.joinable()) {
+        timer_thread_.join();
     }
+
+    std::unique_lock<std::mutex> lock(mutex_timers_);
+
+    timer_heap_.clear();
+
+    for (std::uint32_t slot = 0; slot < timers_.size(); ++ slot) {
+        if (timers_[slot].task) {
+            tasks.push_back(release_timer(slot));
+        }
+    }
+
+    grow_watch_ = false;
 }
 
 void ThreadPool::wait_completion() {
     std::unique_lock<std::mutex> lock(mutex_task_completed_);
-    task_completed_.wait(lock, [this] { return queue_.empty() && busy_ == 0; });
+    task_completed_.wait(lock, [this] { return unfinished_ == 0; });
 }
 
-void ThreadPool::join() {
-    join_ = true;
+void ThreadPool::join(JoinMode mode) {
+    stop_timers();
 
-    wakeup_.notify_all();
+    // the blocking lane drains first, its tasks may still feed the workers
+    std::deque<Task> discarded;
 
-    for (auto& worker : workers_) {
-        worker.join();
+    {
+        std::unique_lock<std::mutex> lock(mutex_blocking_);
+        blocking_join_ = true;
+
+        if (mode == JoinMode::Discard) {
+            discarded.swap(blocking_tasks_);
+        }
     }
 
-    workers_.clear();
+    if ( ! discarded.empty()) {
+        const std::size_t count = discarded.size();
 
-    join_ = false;
-}
+        discarded.clear();
 
-std::size_t ThreadPool::worker_count() const {
-    return workers_.size();
+        if ((unfinished_ -= count) == 0) {
+            std::unique_lock<std::mutex> lock(mutex_task_completed_);
+            task_completed_.notify_all();
+        }
+    }
+
+    blocking_wakeup_.notify_all();
+
+    for (auto& thread : blocking_threads_) {
+        thread.join();
+    }
+
+    // blocking_join_ stays set until join() returns, the blocking lane
+    // refusing tasks until then
+    {
+        std::unique_lock<std::mutex> lock(mutex_blocking_);
+        blocking_threads_.clear();
+        blocking_idle_ = 0;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_wakeup_);
+        join_ = true;
+        discard_ = mode == JoinMode::Discard;
+    }
+
+    // a lane without budget would keep its tasks from being drained, when
+    // discarding they must rather stay queued until dropped
+    std::array<std::size_t, priority_count> budgets{};
+
+    if (mode == JoinMode::Drain) {
+        for (std::size_t lane = 0; lane < priority_count; ++ lane) {
+            budgets[lane] = lanes_[lane].budget.exchange(std::numeric_limits<std::size_t>::max());
+        }
+
+        wakeup_.notify_all();
+    }
+
+    // submitters blocked on a full ring drop their task when discarding
+    {
+        std::unique_lock<std::mutex> lock(mutex_room_);
+        room_.notify_all();
+    }
+
+    // submissions that got past join_ before it was set are queued once
+    // submitting_ falls to 0, later ones are refused
+    while (submitting_ > 0) {
+        std::this_thread::yield();
+    }
+
+    if (mode == JoinMode::Discard) {
+        discard_queued();
+    }
+
+    wakeup_.notify_all();
+
+    // worker_count() changes hands as in spawn(), draining below reuses it
+    AssistScope assisting(*this, true);
+
+    // wait for a worker being started by grow() to be registered
+    std::unique_lock<std::mutex> lock(mutex_workers_);
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // workers may have left before the last submissions were queued
+    if (mode == JoinMode::Drain) {
+        assist();
+    }
+
+    if (mode == JoinMode::Drain) {
+        for (std::size_t lane = 0; lane < priority_count; ++ lane) {
+            lanes_[lane].budget.store(budgets[lane]);
+        }
+    }
+
+    workers_.clear();
+    worker_count_.store(0);
+    active_ = 0;
+
+    publish_queues(0);
+
+    discard_ = false;
+    join_ = false;
+
+    {
+        // timers and growth checks were refused meanwhile
+        std::unique_lock<std::mutex> timers_lock(mutex_timers_);
+        timer_stop_ = false;
+    }
+
+    std::unique_lock<std::mutex> blocking_lock(mutex_blocking_);
+    blocking_join_ = false;
+}
+
+std::size_t ThreadPool::worker_count() const {
+    return worker_count_.load();
+}
+
+std::size_t ThreadPool::active_workers() const {
+    return active_;
+}
+
+std::size_t ThreadPool::node_id(std::size_t thread_id) const {
+    if (slots_.empty() || thread_id >= worker_count()) {
+        return 0;
+    }
+
+    return slots_[thread_id % slots_.size()].node;
+}
+
+std::size_t ThreadPool::node_count() const {
+    return node_count_;
+}
+
+Arena& ThreadPool::arena(std::size_t thread_id) {
+    const QueueTable& table = *table_.load(std::memory_order_acquire);
+
+    if (thread_id >= table.size()) {
+        throw std::out_of_range("no arena for blocking_thread_id or past the workers");
+    }
+
+    return table[thread_id]->arena;
+}
+
+void ThreadPool::reset_arenas() {
+    assert(unfinished_ == 0 && "reset_arenas() called while tasks are queued or run");
+
+    for (WorkQueue* queue : *table_.load(std::memory_order_acquire)) {
+        queue->arena.reset();
+    }
+}
+
+void ThreadPool::set_idle_policy(IdlePolicy policy) {
+    idle_spins_.store(policy.spins, std::memory_order_relaxed);
+    idle_yields_.store(policy.yields, std::memory_order_relaxed);
+}
+
+ThreadPool::IdlePolicy ThreadPool::idle_policy() const {
+    return {
+        idle_spins_.load(std::memory_order_relaxed),
+        idle_yields_.load(std::memory_order_relaxed)
+    };
+}
+
+ThreadPool::IdleStats ThreadPool::idle_stats() const {
+    return {
+        idle_spun_.load(std::memory_order_relaxed),
+        idle_yielded_.load(std::memory_order_relaxed),
+        idle_parked_.load(std::memory_order_relaxed)
+    };
+}
+
+void ThreadPool::set_elastic_policy(ElasticPolicy policy) {
+    min_workers_ = policy.min_workers;
+    retire_after_ = policy.retire_after.count();
+    grow_after_ = std::chrono::duration_cast<std::chrono::nanoseconds>(policy.grow_after).count();
+    last_start_ = now_ns();
+    elastic_ = policy.retire_after.count() > 0 || policy.grow_after.count() > 0;
+
+    // parked workers pick up the new timeout
+    std::unique_lock<std::mutex> lock(mutex_wakeup_);
+    wakeup_.notify_all();
+}
+
+void ThreadPool::set_lane_budget(Priority priority, std::size_t workers) {
+    lanes_[static_cast<std::size_t>(priority)].budget.store(workers, std::memory_order_relaxed);
+
+    // workers parked on a full budget may have room now
+    wake(sleeping_);
+}
+
+void ThreadPool::set_blocking_budget(std::size_t threads) {
+    std::unique_lock<std::mutex> lock(mutex_blocking_);
+    blocking_budget_ = std::max<std::size_t>(threads, 1);
+}
+
+std::size_t ThreadPool::blocking_threads() const {
+    std::unique_lock<std::mutex> lock(mutex_blocking_);
+    return blocking_threads_.size();
+}
+
+std::vector<WorkerStats> ThreadPool::stats() const {
+    std::vector<WorkerStats> stats;
+
+    for (const WorkQueue* queue : *table_.load(std::memory_order_acquire)) {
+        stats.push_back(queue->counters.snapshot());
+    }
+
+    return stats;
+}
+
+void ThreadPool::reset_stats() {
+    for (WorkQueue* queue : *table_.load(std::memory_order_acquire)) {
+        queue->counters.reset();
+    }
+}
+
+void ThreadPool::enable_trace(std::size_t events_per_thread) {
+    if ( ! EE_THREADPOOL_INSTRUMENT) {
+        return;
+    }
+
+    trace_ = false;
+
+    for (WorkQueue* queue : *table_.load(std::memory_order_acquire)) {
+        queue->trace.resize(events_per_thread);
+    }
+
+    trace_origin_ = now_ns();
+    trace_ = events_per_thread > 0;
+}
+
+void ThreadPool::write_trace(std::ostream& out) const {
+    const QueueTable& table = *table_.load(std::memory_order_acquire);
+    std::vector<const detail::TraceRing*> rings;
+
+    for (const WorkQueue* queue : table) {
+        rings.push_back(&queue->trace);
+    }
+
+    detail::write_chrome_trace(out, rings, trace_origin_);
+}
+
+/**
+ * Make queues 0 to nt visible to submitters and thieves, the last one being
+ * the assist() queue.
+ */
+void ThreadPool::publish_queues(std::size_t nt) {
+    while (queues_.size() <= nt) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+
+    auto table = std::make_unique<QueueTable>();
+
+    for (std::size_t i = 0; i <= nt; ++ i) {
+        queues_[i]->node.store(i < nt && ! slots_.empty() ? slots_[i % slots_.size()].node : 0, std::memory_order_relaxed);
+        table->push_back(queues_[i].get());
+    }
+
+    table_.store(table.get(), std::memory_order_release);
+    tables_.push_back(std::move(table));
+}
+
+/**
+ * A worker keeps its own thread_id when it assists, any other thread gets
+ * worker_count().
+ */
+std::size_t ThreadPool::caller_thread_id() const {
+    return current_pool == this ? current_thread_id : worker_count();
+}
+
+ThreadPool::Entry ThreadPool::enqueued(Task&& task, Priority priority) {
+    Entry entry{std::move(task), priority};
+
+#if EE_THREADPOOL_INSTRUMENT
+    entry.submitted = now_ns();
+#endif
+
+    return entry;
+}
+
+bool ThreadPool::push(Task task, Priority priority) {
+    // counted before join_ is read, join() sets join_ before waiting for the
+    // count to fall, either it waits for this task or the task is refused
+    Submission submission(submitting_);
+
+    if (join_) {
+        return false;
+    }
+
+    if (rings_[0]) {
+        push_bounded(std::move(task), priority);
+        wake(1);
+
+        if (elastic_.load(std::memory_order_relaxed)) {
+            grow();
+        }
+
+        return true;
+    }
+
+    const QueueTable& table = *table_.load(std::memory_order_acquire);
+
+    const std::size_t index =
+        current_pool == this && current_thread_id < table.size() ?
+        current_thread_id :
+        next_queue_.fetch_add(1, std::memory_order_relaxed) % table.size();
+
+    WorkQueue& queue = *table[index];
+    const auto lane = static_cast<std::size_t>(priority);
+
+    ++ unfinished_;
+    ++ lanes_[lane].pending;
+
+    {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.lanes[lane].push_back(enqueued(std::move(task), priority));
+    }
+
+    wake(1);
+
+    if (elastic_.load(std::memory_order_relaxed)) {
+        grow();
+    }
+
+    return true;
+}
+
+bool ThreadPool::push_n(std::size_t count, TaskFactory make, void* context, Priority priority) {
+    Submission submission(submitting_);
+
+    if (join_) {
+        return false;
+    }
+
+    if (count == 0) {
+        return true;
+    }
+
+    if (rings_[0]) {
+        for (std::size_t i = 0; i < count; ++ i) {
+            push_bounded(make(context, i), priority);
+        }
+
+        wake(count);
+
+        if (elastic_.load(std::memory_order_relaxed)) {
+            grow();
+        }
+
+        return true;
+    }
+
+    const QueueTable& table = *table_.load(std::memory_order_acquire);
+    const auto lane = static_cast<std::size_t>(priority);
+
+    unfinished_ += count;
+    lanes_[lane].pending += count;
+
+    // with a placement, task i goes to worker i * workers / count so that
+    // neighbouring tasks run on the same node
+    const std::size_t workers = table.size() - 1;
+
+    if (placement_ != Placement::None && workers > 1 && count > 1) {
+        for (std::size_t w = 0; w < workers; ++ w) {
+            const std::size_t first = w * count / workers;
+            const std::size_t last = (w + 1) * count / workers;
+
+            if (first == last) {
+                continue;
+            }
+
+            WorkQueue& queue = *table[w];
+            std::unique_lock<std::mutex> lock(queue.mutex);
+
+            for (std::size_t i = first; i < last; ++ i) {
+                queue.lanes[lane].push_back(enqueued(make(context, i), priority));
+            }
+        }
+    }
+    else {
+        const std::size_t index =
+            current_pool == this && current_thread_id < table.size() ?
+            current_thread_id :
+            next_queue_.fetch_add(1, std::memory_order_relaxed) % table.size();
+
+        WorkQueue& queue = *table[index];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            queue.lanes[lane].push_back(enqueued(make(context, i), priority));
+        }
+    }
+
+    wake(count);
+
+    if (elastic_.load(std::memory_order_relaxed)) {
+        grow();
+    }
+
+    return true;
+}
+
+/**
+ * Queue a task in the ring of its priority, dealing with a full ring as
+ * overflow_ says. A task still waiting for room once a JoinMode::Discard join
+ * starts is dropped as if it had been queued.
+ */
+void ThreadPool::push_bounded(Task&& task, Priority priority) {
+    Entry entry = enqueued(std::move(task), priority);
+    Lane& lane = lanes_[static_cast<std::size_t>(priority)];
+    BoundedQueue<Entry>& ring = *rings_[static_cast<std::size_t>(priority)];
+
+    ++ unfinished_;
+
+    // counted as pending only while it may be in the ring, workers would
+    // otherwise keep looking for it instead of making room
+    auto queued = [&lane, &ring, &entry] {
+        ++ lane.pending;
+
+        if (ring.try_push(std::move(entry))) {
+            return true;
+        }
+
+        -- lane.pending;
+
+        return false;
+    };
+
+    if (queued()) {
+        return;
+    }
+
+    if (overflow_ == Overflow::Inline) {
+        ++ lane.running;
+
+        if (current_pool == this) {
+            execute(current_thread_id, entry);
+        }
+        else {
+            AssistScope assist(*this, true);
+            execute(worker_count(), entry);
+        }
+
+        return;
+    }
+
+    auto drop = [this, &entry] {
+        entry.task = nullptr;
+
+        if (-- unfinished_ == 0) {
+            std::unique_lock<std::mutex> lock(mutex_task_completed_);
+            task_completed_.notify_all();
+        }
+    };
+
+    // whoever is asleep has to make room
+    wake(sleeping_);
+
+    const bool worker = current_pool == this;
+
+    for (std::size_t attempt = 0; ! queued(); ++ attempt) {
+        Entry other;
+
+        if (discard_) {
+            drop();
+            return;
+        }
+
+        if (worker && pop(current_thread_id, other)) {
+            execute(current_thread_id, other);
+        }
+        else if (worker || overflow_ == Overflow::Spin) {
+            if (attempt < idle_spins_.load(std::memory_order_relaxed)) {
+                cpu_relax();
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+        else {
+            std::unique_lock<std::mutex> lock(mutex_room_);
+
+            ++ blocked_;
+
+            // pairs with the fence of made_room(), either the consumer sees
+            // blocked_ or the retry sees the freed cell
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // join() notifies once discard_ is set
+            while ( ! queued()) {
+                if (discard_) {
+                    -- blocked_;
+                    lock.unlock();
+                    drop();
+
+                    return;
+                }
+
+                room_.wait(lock);
+            }
+
+            -- blocked_;
+
+            return;
+        }
+    }
+}
+
+/**
+ * Wake submitters blocked on a full ring after a task was taken out.
+ */
+void ThreadPool::made_room() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (blocked_.load(std::memory_order_relaxed) > 0) {
+        std::unique_lock<std::mutex> lock(mutex_room_);
+        room_.notify_all();
+    }
+}
+
+/**
+ * Queue a task on the blocking lane, starting a thread for it if none is
+ * waiting and the budget allows.
+ */
+bool ThreadPool::push_blocking(Task&& task) {
+    std::unique_lock<std::mutex> lock(mutex_blocking_);
+
+    if (blocking_join_ || join_) {
+        return false;
+    }
+
+    ++ unfinished_;
+    blocking_tasks_.push_back(std::move(task));
+
+    // every waiting thread is already due to take one of the queued tasks
+    if (blocking_tasks_.size() <= blocking_idle_ || blocking_threads_.size() >= blocking_budget_) {
+        blocking_wakeup_.notify_one();
+
+        return true;
+    }
+
+    blocking_threads_.emplace_back([this] {
+        std::unique_lock<std::mutex> lock(mutex_blocking_);
+
+        while (true) {
+            if (blocking_tasks_.empty()) {
+                if (blocking_join_) {
+                    return;
+                }
+
+                ++ blocking_idle_;
+                blocking_wakeup_.wait(lock);
+                -- blocking_idle_;
+
+                continue;
+            }
+
+            Task task = std::move(blocking_tasks_.front());
+            blocking_tasks_.pop_front();
+
+            lock.unlock();
+
+            task(blocking_thread_id);
+            task = nullptr;
+
+            if (-- unfinished_ == 0) {
+                std::unique_lock<std::mutex> completed_lock(mutex_task_completed_);
+                task_completed_.notify_all();
+            }
+
+            lock.lock();
+        }
+    });
+
+    return true;
+}
+
+/**
+ * Drop every queued task without running it.
+ */
+void ThreadPool::discard_queued() {
+    std::vector<Entry> discarded;
+
+    for (std::size_t lane = 0; lane < priority_count; ++ lane) {
+        std::size_t count = 0;
+
+        if (rings_[0]) {
+            Entry entry;
+
+            while (rings_[lane]->try_pop(entry)) {
+                discarded.push_back(std::move(entry));
+                ++ count;
+            }
+
+            made_room();
+        }
+        else {
+            for (WorkQueue* queue : *table_.load(std::memory_order_acquire)) {
+                std::unique_lock<std::mutex> lock(queue->mutex);
+                Deque& deque = queue->lanes[lane];
+
+                while (deque.size > 0) {
+                    discarded.push_back(deque.pop_front());
+                    ++ count;
+                }
+            }
+        }
+
+        lanes_[lane].pending -= count;
+    }
+
+    const std::size_t count = discarded.size();
+
+    // tasks may complete a TaskGroup or break a promise as they are destroyed
+    discarded.clear();
+
+    if (count > 0 && (unfinished_ -= count) == 0) {
+        std::unique_lock<std::mutex> lock(mutex_task_completed_);
+        task_completed_.notify_all();
+    }
+}
+
+/**
+ * Wake up to count sleeping workers.
+ */
+void ThreadPool::wake(std::size_t count) {
+    // pending counts are raised before sleeping_ is read and a worker raises
+    // sleeping_ before checking them, one of them sees the other
+    const std::size_t sleeping = sleeping_;
+
+    if (sleeping == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_wakeup_);
+
+    if (count >= sleeping) {
+        wakeup_.notify_all();
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++ i) {
+        wakeup_.notify_one();
+    }
+}
+
+/**
+ * Tasks queued in all lanes.
+ */
+std::size_t ThreadPool::pending() const {
+    std::size_t count = 0;
+
+    for (const Lane& lane : lanes_) {
+        count += lane.pending;
+    }
+
+    return count;
+}
+
+/**
+ * Whether a lane has queued tasks and room in its budget.
+ */
+bool ThreadPool::workable() const {
+    for (const Lane& lane : lanes_) {
+        if (lane.pending > 0 && lane.running < lane.budget.load(std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Count the caller as running a task of lane, unless over budget.
+ */
+bool ThreadPool::reserve(Lane& lane) {
+    const std::size_t budget = lane.budget.load(std::memory_order_relaxed);
+
+    if (budget == std::numeric_limits<std::size_t>::max()) {
+        ++ lane.running;
+        return true;
+    }
+
+    std::size_t running = lane.running;
+
+    do {
+        if (running >= budget) {
+            return false;
+        }
+    } while ( ! lane.running.compare_exchange_weak(running, running + 1));
+
+    return true;
+}
+
+/**
+ * Uncount the caller from running tasks of lane, a worker may have parked
+ * while the lane was at its budget.
+ */
+void ThreadPool::release(Lane& lane) {
+    -- lane.running;
+
+    if (lane.pending > 0 && lane.budget.load(std::memory_order_relaxed) != std::numeric_limits<std::size_t>::max()) {
+        wake(1);
+    }
+}
+
+/**
+ * Take a task from the highest priority lane having one and room in its
+ * budget.
+ */
+bool ThreadPool::pop(std::size_t thread_id, Entry& entry) {
+    for (std::size_t lane = 0; lane < priority_count; ++ lane) {
+        if (lanes_[lane].pending == 0 || ! reserve(lanes_[lane])) {
+            continue;
+        }
+
+        if (pop_lane(thread_id, lane, entry)) {
+            return true;
+        }
+
+        release(lanes_[lane]);
+    }
+
+    return false;
+}
+
+bool ThreadPool::pop_lane(std::size_t thread_id, std::size_t lane, Entry& entry) {
+    if (rings_[0]) {
+        if ( ! rings_[lane]->try_pop(entry)) {
+            return false;
+        }
+
+        -- lanes_[lane].pending;
+        made_room();
+
+        return true;
+    }
+
+    const QueueTable& table = *table_.load(std::memory_order_acquire);
+    const std::size_t count = table.size();
+
+    // own queue first, newest task
+    if (thread_id < count) {
+        WorkQueue& queue = *table[thread_id];
+        Deque& deque = queue.lanes[lane];
+
+        if (deque.size > 0) {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+
+            if (deque.size > 0) {
+                entry = deque.pop_back();
+                -- lanes_[lane].pending;
+
+                return true;
+            }
+        }
+    }
+
+    // then steal from another queue, preferring queues of the same node
+    const std::size_t node = thread_id < count ? table[thread_id]->node.load(std::memory_order_relaxed) : 0;
+
+    for (bool same_node : {true, false}) {
+        for (std::size_t i = 1; i <= count; ++ i) {
+            WorkQueue& victim = *table[(thread_id + i) % count];
+
+            if ((victim.node.load(std::memory_order_relaxed) == node) == same_node &&
+                steal(victim, lane, thread_id, table, entry)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Take the oldest task of a lane of victim, along with up to half of its
+ * other tasks when the thief has a queue to keep the ones it does not run
+ * right away.
+ */
+bool ThreadPool::steal(WorkQueue& victim, std::size_t lane, std::size_t thread_id, const QueueTable& table, Entry& entry) {
+    Deque& deque = victim.lanes[lane];
+
+    if (deque.size == 0) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(victim.mutex);
+
+    if (deque.size == 0) {
+        return false;
+    }
+
+    entry = deque.pop_front();
+
+    const std::size_t extra =
+        thread_id < table.size() && &victim != table[thread_id] ?
+        std::min(deque.size / 2, steal_batch) :
+        0;
+
+    if (extra > 0) {
+        std::array<Entry, steal_batch> stolen;
+
+        for (std::size_t k = 0; k < extra; ++ k) {
+            stolen[k] = deque.pop_front();
+        }
+
+        lock.unlock();
+
+        WorkQueue& queue = *table[thread_id];
+        std::unique_lock<std::mutex> own_lock(queue.mutex);
+
+        for (std::size_t k = 0; k < extra; ++ k) {
+            queue.lanes[lane].push_back(std::move(stolen[k]));
+        }
+    }
+
+    -- lanes_[lane].pending;
+
+    return true;
+}
+
+/**
+ * Restart a retired worker right away if none is active. Otherwise, when
+ * every active worker is busy, have the timer thread watch for tasks waiting
+ * longer than grow_after.
+ */
+void ThreadPool::grow() {
+    const std::size_t active = active_;
+
+    if (active >= worker_count()) {
+        return;
+    }
+
+    if (active == 0) {
+        restart_worker();
+        return;
+    }
+
+    if (grow_after_.load(std::memory_order_relaxed) == 0 || sleeping_ > 0) {
+        return;
+    }
+
+    // read after the pending count was raised, see run_timers()
+    if (grow_watch_ || grow_watch_.exchange(true)) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_timers_);
+
+    // no timer thread while joining
+    if (timer_stop_) {
+        grow_watch_ = false;
+        return;
+    }
+
+    start_timer_thread();
+    timer_wakeup_.notify_one();
+}
+
+/**
+ * Called by the timer thread while it watches, restart a retired worker if
+ * tasks are queued, no task started for grow_after and no active worker is
+ * parked. Return false once there is nothing left to watch.
+ */
+bool ThreadPool::grow_due(std::chrono::nanoseconds::rep now) {
+    const auto grow_after = grow_after_.load(std::memory_order_relaxed);
+
+    if (grow_after == 0 || pending() == 0 || active_ >= worker_count()) {
+        return false;
+    }
+
+    if (sleeping_ == 0 && now - last_start_.load(std::memory_order_relaxed) >= grow_after) {
+        // let the new worker show progress before growing again
+        last_start_.store(now, std::memory_order_relaxed);
+        restart_worker();
+    }
+
+    return true;
+}
+
+/**
+ * Start the thread of the first retired worker, if any.
+ */
+void ThreadPool::restart_worker() {
+    std::unique_lock<std::mutex> lock(mutex_workers_, std::try_to_lock);
+
+    if ( ! lock || join_) {
+        return;
+    }
+
+    for (std::size_t thread_id = 0; thread_id < workers_.size(); ++ thread_id) {
+        if (queues_[thread_id]->retired) {
+            workers_[thread_id].join();
+            start_worker(thread_id);
+
+            return;
+        }
+    }
+}
+
+/**
+ * Retire the calling worker unless it is needed to keep min_workers active or
+ * to run a task queued meanwhile.
+ */
+bool ThreadPool::retire(std::size_t thread_id) {
+    std::size_t active = active_;
+
+    while (active > min_workers_) {
+        if (active_.compare_exchange_weak(active, active - 1)) {
+            // a submitter raises a pending count before checking active_
+            if (workable()) {
+                ++ active_;
+                return false;
+            }
+
+            (*table_.load(std::memory_order_acquire))[thread_id]->retired = true;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Wait for a task to be queued following the idle policy. Return false when
+ * the pool is being joined and no task is left, or when the worker retires.
+ */
+bool ThreadPool::idle(std::size_t thread_id) {
+#if EE_THREADPOOL_INSTRUMENT
+    struct IdleRecord {
+        ThreadPool& pool;
+        std::size_t thread_id;
+        std::chrono::nanoseconds::rep start = now_ns();
+
+        ~IdleRecord() {
+            const auto end = now_ns();
+            WorkQueue& queue = *(*pool.table_.load(std::memory_order_acquire))[thread_id];
+
+            queue.counters.record_idle(end - start);
+
+            if (pool.trace_.load(std::memory_order_relaxed)) {
+                queue.trace.record({start, end - start, 0, true});
+            }
+        }
+    } idle_record{*this, thread_id};
+#endif
+
+    const std::size_t spins = idle_spins_.load(std::memory_order_relaxed);
+    const std::size_t yields = idle_yields_.load(std::memory_order_relaxed);
+
+    for (std::size_t i = 0; i < spins && ! join_; ++ i) {
+        if (workable()) {
+            idle_spun_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        cpu_relax();
+    }
+
+    for (std::size_t i = 0; i < yields && ! join_; ++ i) {
+        if (workable()) {
+            idle_yielded_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_wakeup_);
+
+    ++ sleeping_;
+
+    while ( ! join_ && ! workable()) {
+        const auto retire_after = std::chrono::milliseconds(retire_after_.load(std::memory_order_relaxed));
+
+        if (retire_after.count() == 0) {
+            wakeup_.wait(lock);
+        }
+        else if (wakeup_.wait_for(lock, retire_after) == std::cv_status::timeout &&
+                 ! join_ && ! workable() && retire(thread_id)) {
+            -- sleeping_;
+            return false;
+        }
+    }
+
+    -- sleeping_;
+
+    idle_parked_.fetch_add(1, std::memory_order_relaxed);
+
+    return ! join_ || workable();
+}
+
+void ThreadPool::execute(std::size_t thread_id, Entry& entry) {
+#if EE_THREADPOOL_INSTRUMENT
+    const auto start = now_ns();
+    const std::size_t depth = pending();
+#endif
+
+    entry.task(thread_id);
+    entry.task = nullptr;
+
+    release(lanes_[static_cast<std::size_t>(entry.priority)]);
+
+#if EE_THREADPOOL_INSTRUMENT
+    const auto end = now_ns();
+    WorkQueue& queue = *(*table_.load(std::memory_order_acquire))[thread_id];
+
+    queue.counters.record_task(start - entry.submitted, end - start, depth);
+
+    if (trace_.load(std::memory_order_relaxed)) {
+        queue.trace.record({start, end - start, start - entry.submitted, false});
+    }
+#endif
+
+    if (-- unfinished_ == 0) {
+        std::unique_lock<std::mutex> lock(mutex_task_completed_);
+        task_completed_.notify_all();
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool, ThreadPool::Priority priority) :
+    pool_{pool},
+    priority_{priority} {}
+
+TaskGroup::TaskGroup(ThreadPool& pool, CancelToken token, ThreadPool::Priority priority) :
+    pool_{pool},
+    priority_{priority},
+    token_{std::move(token)} {}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    }
+    catch (...) {
+        // exceptions are only reported by an explicit wait()
+    }
+}
+
+void TaskGroup::wait() {
+    auto help = ThreadPool::Help::Empty;
+
+    while (pending_ > 1 && (help = pool_.help(false)) == ThreadPool::Help::Ran) {
+        if (pool_.elastic_.load(std::memory_order_relaxed) && pool_.pending() > 0) {
+            pool_.grow();
+        }
+    }
+
+    // drop the group's own token, whoever brings pending_ to 0 signals
+    if (pending_.fetch_sub(1) != 1) {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        // another thread was running tasks as worker_count(), help again
+        // once it is done in case no worker takes the group's tasks
+        while (help == ThreadPool::Help::Busy && ! completed_.wait_for(lock, assist_retry, [this] { return done_; })) {
+            lock.unlock();
+
+            do {
+                help = pool_.help(false);
+            } while (help == ThreadPool::Help::Ran && pending_ > 0);
+
+            lock.lock();
+        }
+
+        completed_.wait(lock, [this] { return done_; });
+    }
+
+    pending_ = 1;
+    done_ = false;
+
+    if (exception_) {
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+    }
+}
+
+/**
+ * Keep the first exception of the group's tasks.
+ */
+void TaskGroup::fail(std::exception_ptr exception) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if ( ! exception_) {
+        exception_ = std::move(exception);
+    }
+}
+
+void TaskGroup::complete(std::size_t count) {
+    if (pending_.fetch_sub(count) == count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_ = true;
+        completed_.notify_one();
+    }
+}
+
+void ThreadPool::Deque::push_back(Entry&& entry) {
+    const std::size_t count = size.load(std::memory_order_relaxed);
+
+    if (count == ring.size()) {
+        std::vector<Entry> grown(ring.size() * 2);
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            grown[i] = std::move(ring[(head + i) % ring.size()]);
+        }
+
+        ring = std::move(grown);
+        head = 0;
+    }
+
+    ring[(head + count) % ring.size()] = std::move(entry);
+    size.store(count + 1, std::memory_order_relaxed);
+}
+
+ThreadPool::Entry ThreadPool::Deque::pop_back() {
+    const std::size_t count = size.load(std::memory_order_relaxed) - 1;
+
+    size.store(count, std::memory_order_relaxed);
+
+    return std::move(ring[(head + count) % ring.size()]);
+}
+
+ThreadPool::Entry ThreadPool::Deque::pop_front() {
+    Entry entry = std::move(ring[head]);
+
+    head = (head + 1) % ring.size();
+    size.store(size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+
+    return entry;
 }
 
-} // namespace ee
\ No newline at end of file
+} // namespace ee
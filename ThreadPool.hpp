@@ -7,73 +7,885 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
+#include <memory>
 #include <thread>
-#include <queue>
-#include <functional>
+#include <tuple>
 #include <condition_variable>
+#include <deque>
+#include <limits>
 #include <mutex>
-#include <future>
 #include <atomic>
+#include <exception>
+#include <optional>
+
+#include "Arena.hpp"
+#include "BoundedQueue.hpp"
+#include "CancelToken.hpp"
+#include "Instrumentation.hpp"
+#include "Task.hpp"
+#include "Future.hpp"
+
+/**
+ * Set to 1 for the whole build to record per thread_id statistics and allow
+ * tracing, see ThreadPool::stats and ThreadPool::enable_trace.
+ */
+#if ! defined(EE_THREADPOOL_INSTRUMENT)
+#define EE_THREADPOOL_INSTRUMENT 0
+#endif
 
 namespace ee {
 
+/**
+ * Work stealing thread pool.
+ * Each worker owns a task deque, tasks submitted from a worker go to its own
+ * deque and are popped back in LIFO order while idle workers steal the oldest
+ * tasks from the front of the others. Tasks submitted from any other thread
+ * are spread over all the deques, including the one reserved to assist().
+ * Callbacks receive a thread_id, 0 to worker_count()-1 for workers and
+ * worker_count() for threads outside the pool running its tasks, in assist(),
+ * TaskGroup::wait() or on a full bounded queue. Those take turns task by
+ * task, so that a thread_id is used by a single thread at a time and per
+ * thread_id state needs no lock. A thread waiting for a TaskGroup while
+ * another one holds worker_count() leaves the tasks to the workers,
+ * checking back from time to time.
+ * Once the pool is warmed up, submitting a callable fitting in Task's inline
+ * storage does not allocate.
+ * A QueuePolicy with a capacity swaps the deques for one bounded lock-free
+ * FIFO shared by all threads.
+ * Tasks have a Priority, each priority being a lane of its own that may be
+ * limited to a number of workers. Tasks that block go to a separate lane
+ * served by threads of its own, see arun_blocking(), their thread_id being
+ * blocking_thread_id.
+ * Tasks may be submitted for later, a single timer thread owned by the pool
+ * queuing them as they come due.
+ * Tasks submitted with a CancelToken are dropped if it is cancelled by the
+ * time they start, their Future then throwing Cancelled.
+ */
 class ThreadPool {
     public:
-        ThreadPool(size_t = 0);
+        /**
+         * How an idle worker waits for work: up to spins checks separated by
+         * a pause instruction, then up to yields checks separated by a
+         * yield, then it parks on a condition variable until woken.
+         */
+        struct IdlePolicy {
+            std::size_t spins = 256;
+            std::size_t yields = 16;
+        };
+
+        /**
+         * Where workers run.
+         *  - None: workers are not pinned, the OS places them.
+         *  - Compact: worker i is pinned to the i-th allowed core, cores being
+         *    ordered node by node so that consecutive workers share a node.
+         *  - Scatter: workers are pinned round robin over the NUMA nodes.
+         * With a placement, stealing prefers workers of the same node and
+         * bulk submissions give contiguous ranges of tasks to contiguous
+         * workers.
+         */
+        enum class Placement {
+            None,
+            Compact,
+            Scatter
+        };
+
+        /**
+         * Let the pool give cores back and take them again, thread_ids
+         * staying in [0, worker_count()).
+         * A worker parked for retire_after retires as long as more than
+         * min_workers are active, its thread_id is handed to the next worker
+         * started. A retired worker is started again when tasks are queued,
+         * no task started for grow_after and no active worker is parked, or
+         * when no worker is active at all. Once a submission finds every
+         * active worker busy, the pool's timer thread checks how long ago a
+         * task last started until the queues empty, so a burst queued behind
+         * a long task gets a worker after grow_after however short it is.
+         * Zero durations disable retiring and growing.
+         */
+        struct ElasticPolicy {
+            std::size_t min_workers = 0;
+            std::chrono::milliseconds retire_after{0};
+            std::chrono::microseconds grow_after{0};
+        };
+
+        /**
+         * Queued tasks are taken by priority, every High task before any
+         * Normal one and so on, a running task is never preempted.
+         */
+        enum class Priority {
+            High,
+            Normal,
+            Low
+        };
+
+        static constexpr std::size_t priority_count = 3;
+
+        /**
+         * What a submitter does when the bounded queue is full.
+         *  - Block: sleep until a task is taken out.
+         *  - Spin: retry with pauses and yields.
+         *  - Inline: run the task right away on the submitting thread.
+         * A worker submitting to a full queue runs queued tasks meanwhile
+         * instead of blocking or spinning, so that it cannot starve its own
+         * pool. Block and Spin rely on workers to make room.
+         */
+        enum class Overflow {
+            Block,
+            Spin,
+            Inline
+        };
+
+        /**
+         * Where tasks are queued. With a capacity of 0, each thread_id owns an
+         * unbounded work stealing deque per priority. Otherwise all tasks of a
+         * priority go through a single lock-free ring of capacity tasks
+         * allocated up front, oldest first, no submission allocating once
+         * tasks fit Task's inline storage.
+         */
+        struct QueuePolicy {
+            std::size_t capacity = 0;
+            Overflow overflow = Overflow::Block;
+        };
+
+        /**
+         * What join() does with tasks still queued: run them all, or drop
+         * them, their Future throwing std::future_error and their TaskGroup
+         * Cancelled. Tasks already running complete either way.
+         */
+        enum class JoinMode {
+            Drain,
+            Discard
+        };
+
+        /**
+         * Number of idle waits that ended in each phase of the IdlePolicy.
+         */
+        struct IdleStats {
+            std::size_t spun = 0;
+            std::size_t yielded = 0;
+            std::size_t parked = 0;
+        };
+
+        /**
+         * Awaitable moving the awaiting coroutine to a pool thread, co_await
+         * gives the thread_id it resumes on. If the pool is being joined the
+         * coroutine simply goes on where it is. If join(Discard) drops it
+         * once queued, it is resumed by the thread dropping it and co_await
+         * throws Cancelled.
+         */
+        class ScheduleAwaitable {
+            public:
+                explicit ScheduleAwaitable(ThreadPool& pool) :
+                    pool_{pool} {}
+
+                bool await_ready() const noexcept {
+                    return false;
+                }
+
+                template <typename Handle>
+                bool await_suspend(Handle handle) {
+                    thread_id_ = pool_.caller_thread_id();
+
+                    auto make = [this, handle](std::size_t) -> Task {
+                        return [resumer = Resumer<Handle>{this, handle}](std::size_t thread_id) mutable {
+                            resumer.resume(thread_id);
+                        };
+                    };
+
+                    // the task is only made once the pool accepted it, the
+                    // coroutine may run elsewhere as soon as it is
+                    return pool_.push_n(1, &ThreadPool::make_task<decltype(make)>, &make);
+                }
+
+                std::size_t await_resume() const {
+                    if (cancelled_) {
+                        throw Cancelled{};
+                    }
+
+                    return thread_id_;
+                }
+
+            private:
+                /**
+                 * Held by the pushed task. Resumes the coroutine as the task
+                 * runs, or as it is destroyed without having run.
+                 */
+                template <typename Handle>
+                class Resumer {
+                    public:
+                        Resumer(ScheduleAwaitable* awaitable, Handle handle) :
+                            awaitable_{awaitable},
+                            handle_{handle} {}
+
+                        Resumer(Resumer&& other) noexcept :
+                            awaitable_{std::exchange(other.awaitable_, nullptr)},
+                            handle_{other.handle_} {}
+
+                        Resumer& operator=(Resumer&&) = delete;
+
+                        ~Resumer() {
+                            if (awaitable_) {
+                                awaitable_->cancelled_ = true;
+                                handle_.resume();
+                            }
+                        }
+
+                        void resume(std::size_t thread_id) {
+                            std::exchange(awaitable_, nullptr)->thread_id_ = thread_id;
+                            handle_.resume();
+                        }
+
+                    private:
+                        ScheduleAwaitable* awaitable_;
+                        Handle handle_;
+                };
+
+                ThreadPool& pool_;
+                std::size_t thread_id_ = 0;
+                bool cancelled_ = false;
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * Handle of a timed task, 0 when it could not be set as the pool is
+         * being joined.
+         */
+        using TimerId = std::uint64_t;
+
+        ThreadPool(size_t = 0, Placement = Placement::None);
+        ThreadPool(size_t, Placement, QueuePolicy);
         ~ThreadPool();
 
+        /**
+         * Add workers, their thread_ids following the current ones. Waits
+         * for the thread running a task as worker_count(), if any, since that
+         * thread_id goes to the first new worker. Must not be called from a
+         * pool task.
+         */
         void spawn(size_t);
 
+        /**
+         * Run fn(thread_id, args...) on the pool. The result comes as an
+         * ee::Future rather than a std::future, see Future.hpp.
+         */
+        template <class Fn, class... Args>
+        auto arun(Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))>;
+
+        template <class Fn, class... Args>
+        auto arun(Priority, Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))>;
+
+        template <class Fn, class... Args>
+        auto arun(const CancelToken&, Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))>;
+
         template <class Fn, class... Args>
-        auto arun(Fn&& fn, Args&&... args) -> std::future<decltype(fn(std::size_t{}, args...))>;
+        auto arun(const CancelToken&, Priority, Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))>;
+
+        /**
+         * Run fn(thread_id, args...) on the blocking lane, for tasks spending
+         * their time waiting (file or network I/O) rather than computing.
+         * They run on threads of their own, started as needed up to the
+         * blocking budget on top of the workers, and never hold a worker.
+         * They receive blocking_thread_id as thread_id, which indexes no per
+         * thread_id state: arena() and WorkerLocal refuse it.
+         */
+        template <class Fn, class... Args>
+        auto arun_blocking(Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))>;
 
         template <class Fn, class... Args>
         auto run(Fn&& fn, Args&&... args) -> decltype(fn(std::size_t{}, args...));
 
+        /**
+         * Submit count fire and forget tasks calling fn(thread_id, i) for i in
+         * [0, count), each holding its own copy of fn. They are queued under a
+         * single lock and at most count sleeping workers are woken. Nothing
+         * waits for these tasks, an exception one of them throws is dropped.
+         */
+        template <class Fn>
+        void post_n(std::size_t count, Fn&& fn);
+
+        /**
+         * Queue fn(thread_id) at time, after delay, or every period starting
+         * one period from now. A periodic run is skipped while the previous
+         * one still runs. Timers not due yet are dropped by join().
+         * Setting a timer allocates the shared state of its callable, runs
+         * are queued without allocating. An exception a run throws is
+         * dropped, a periodic timer firing again all the same.
+         */
+        template <class Fn>
+        TimerId run_at(Clock::time_point time, Fn&& fn);
+
+        template <class Fn>
+        TimerId run_after(Clock::duration delay, Fn&& fn);
+
+        template <class Fn>
+        TimerId run_every(Clock::duration period, Fn&& fn);
+
+        /**
+         * Drop a timer in constant time, false if it already fired for good
+         * or was cancelled. A run already queued still happens.
+         */
+        bool cancel(TimerId);
+
+        /**
+         * co_await pool.schedule() resumes the coroutine on a pool thread,
+         * see Coroutine.hpp.
+         */
+        ScheduleAwaitable schedule() {
+            return ScheduleAwaitable{*this};
+        }
+
+        /**
+         * Run queued tasks until there are none left, as worker_count()
+         * unless called from a worker.
+         */
         void assist();
         void wait_completion();
-        void join();
 
+        /**
+         * Stop the timers, the blocking lane then the workers. Tasks
+         * submitted once join() started are refused, those whose submission
+         * was under way are queued then run or dropped as mode says. While
+         * draining, lane budgets are lifted so that every lane empties.
+         */
+        void join(JoinMode = JoinMode::Drain);
+
+        /**
+         * Workers have thread_ids 0 to worker_count()-1, threads outside the
+         * pool running its tasks take turns on worker_count(), blocking lane
+         * tasks get blocking_thread_id.
+         */
         std::size_t worker_count() const;
+        std::size_t active_workers() const;
+
+        // thread_id of blocking lane tasks, past any worker or assisting one
+        static constexpr std::size_t blocking_thread_id = std::numeric_limits<std::size_t>::max();
+
+        /**
+         * NUMA node of the worker given its thread_id, as read from sysfs.
+         * Node 0 when the pool has no placement and for the assisting thread.
+         */
+        std::size_t node_id(std::size_t thread_id) const;
+        std::size_t node_count() const;
+
+        /**
+         * Scratch arena of a thread_id up to worker_count(), the latter
+         * being the assisting thread, std::out_of_range thrown for others.
+         * Each thread_id having one user at a time, allocations take no
+         * lock. reset_arenas() must not be called while tasks are queued or
+         * run.
+         */
+        Arena& arena(std::size_t thread_id);
+        void reset_arenas();
+
+        void set_idle_policy(IdlePolicy);
+        IdlePolicy idle_policy() const;
+        IdleStats idle_stats() const;
+
+        void set_elastic_policy(ElasticPolicy);
+
+        /**
+         * Most threads running tasks of a priority at once, unlimited by
+         * default. Tasks over budget stay queued even if workers are idle, a
+         * budget of 0 holds the lane.
+         */
+        void set_lane_budget(Priority, std::size_t workers);
+
+        /**
+         * Most threads of the blocking lane, at least 1, hardware concurrency
+         * by default. Threads already started are kept until join().
+         */
+        void set_blocking_budget(std::size_t threads);
+        std::size_t blocking_threads() const;
+
+        /**
+         * Statistics of each thread_id since the last reset, the last entry
+         * being the assisting thread. Only recorded when EE_THREADPOOL_INSTRUMENT
+         * is set, all zeros otherwise.
+         */
+        std::vector<WorkerStats> stats() const;
+        void reset_stats();
+
+        /**
+         * Keep the last events_per_thread task and idle spans of each
+         * thread_id, 0 stops tracing. Requires EE_THREADPOOL_INSTRUMENT, must
+         * not be called while tasks run.
+         */
+        void enable_trace(std::size_t events_per_thread);
+
+        /**
+         * Write recorded spans as Chrome trace event JSON, for chrome://tracing
+         * or Perfetto. Should be called while no task runs.
+         */
+        void write_trace(std::ostream&) const;
 
     private:
+        friend class TaskGroup;
+
+        struct AssistScope;
+
+        // outcome of a help() call
+        enum class Help {
+            Ran,
+            Empty,
+            Busy
+        };
+
+        /**
+         * Queued task, stamped with its submission time when instrumented.
+         */
+        struct Entry {
+            Task task;
+            Priority priority = Priority::Normal;
+#if EE_THREADPOOL_INSTRUMENT
+            std::int64_t submitted = 0;
+#endif
+        };
+
+        /**
+         * Growable ring of tasks whose storage is kept once grown.
+         */
+        struct Deque {
+            std::vector<Entry> ring = std::vector<Entry>(64);
+            std::size_t head = 0;
+            std::atomic<std::size_t> size{0};
+
+            void push_back(Entry&&);
+            Entry pop_back();
+            Entry pop_front();
+        };
+
+        /**
+         * Per thread_id state, mostly a deque per priority under one lock.
+         */
+        struct alignas(Arena::cache_line) WorkQueue {
+            std::mutex mutex;
+            std::array<Deque, priority_count> lanes;
+            std::atomic<std::size_t> node{0};
+            std::atomic<bool> retired{false};
+            Arena arena;
+            detail::WorkerCounters counters;
+            detail::TraceRing trace;
+        };
+
+        /**
+         * Per priority counters, running counting threads that took a task
+         * of the lane and did not complete it yet.
+         */
+        struct alignas(Arena::cache_line) Lane {
+            std::atomic<std::size_t> pending{0};
+            std::atomic<std::size_t> running{0};
+            std::atomic<std::size_t> budget{std::numeric_limits<std::size_t>::max()};
+        };
+
+        /**
+         * Callable of a timer, shared with its queued runs.
+         */
+        struct TimerTask {
+            Task task;
+            std::atomic<bool> running{false};
+        };
+
+        /**
+         * Timer slots are reused, a generation telling their successive
+         * timers apart so that cancelled ones are left in the heap and
+         * skipped when they come up.
+         */
+        struct TimerSlot {
+            std::shared_ptr<TimerTask> task;
+            Clock::duration period{0};
+            std::uint32_t generation = 1;
+        };
+
+        struct TimerDue {
+            Clock::time_point time;
+            std::uint32_t slot;
+            std::uint32_t generation;
+
+            bool operator>(const TimerDue& other) const {
+                return time > other.time;
+            }
+        };
+
+        // core and NUMA node a worker is pinned to
+        struct Slot {
+            unsigned int cpu;
+            std::size_t node;
+        };
+
+        using QueueTable = std::vector<WorkQueue*>;
+        using TaskFactory = Task (*)(void*, std::size_t);
+
+        static constexpr std::size_t steal_batch = 32;
+
+        template <typename Make>
+        static Task make_task(void*, std::size_t);
+
+        TimerId add_timer(Clock::time_point, Clock::duration, Task);
+        void start_timer_thread();
+        void run_timers();
+        void stop_timers();
+        std::shared_ptr<TimerTask> release_timer(std::uint32_t);
+        void start_worker(std::size_t);
+        void publish_queues(std::size_t);
+        std::size_t caller_thread_id() const;
+        static Entry enqueued(Task&&, Priority);
+        bool push(Task, Priority = Priority::Normal);
+        bool push_n(std::size_t, TaskFactory, void*, Priority = Priority::Normal);
+        void push_bounded(Task&&, Priority);
+        bool push_blocking(Task&&);
+        void discard_queued();
+        void made_room();
+        std::size_t pending() const;
+        bool workable() const;
+        bool reserve(Lane&);
+        void release(Lane&);
+        bool pop_lane(std::size_t, std::size_t, Entry&);
+        bool steal(WorkQueue&, std::size_t, std::size_t, const QueueTable&, Entry&);
+        void wake(std::size_t);
+        void grow();
+        bool grow_due(std::chrono::nanoseconds::rep now);
+        void restart_worker();
+        bool retire(std::size_t);
+        bool idle(std::size_t);
+        bool pop(std::size_t, Entry&);
+        void execute(std::size_t, Entry&);
+        Help help(bool block);
+
+        // scopes holding worker_count() on the current thread, innermost first
+        static thread_local AssistScope* assist_scopes_;
+
         std::atomic<bool> join_{false};
-        std::atomic<unsigned int> busy_{0};
+        std::atomic<bool> discard_{false};
+        std::atomic<std::size_t> submitting_{0};
+        std::atomic<std::size_t> unfinished_{0};
+        std::atomic<std::size_t> sleeping_{0};
+        std::atomic<std::size_t> next_queue_{0};
+
+        // queued tasks are counted per lane only
+        std::array<Lane, priority_count> lanes_;
+
+        std::atomic<std::size_t> idle_spins_{IdlePolicy{}.spins};
+        std::atomic<std::size_t> idle_yields_{IdlePolicy{}.yields};
+        std::atomic<std::size_t> idle_spun_{0};
+        std::atomic<std::size_t> idle_yielded_{0};
+        std::atomic<std::size_t> idle_parked_{0};
+
+        std::atomic<bool> elastic_{false};
+        std::atomic<std::size_t> active_{0};
+        std::atomic<std::size_t> min_workers_{0};
+        std::atomic<std::chrono::milliseconds::rep> retire_after_{0};
+        std::atomic<std::chrono::nanoseconds::rep> grow_after_{0};
+        std::atomic<std::chrono::nanoseconds::rep> last_start_{0};
+
+        // set while the timer thread watches for tasks waiting to grow
+        std::atomic<bool> grow_watch_{false};
 
+        std::atomic<bool> trace_{false};
+        std::chrono::nanoseconds::rep trace_origin_{0};
+
+        // workers_ is only touched under mutex_workers_, its size being
+        // published in worker_count_ for everyone else
         std::vector<std::thread> workers_;
-        std::queue<std::function<void(std::size_t)>> queue_;
+        std::atomic<std::size_t> worker_count_{0};
+
+        Placement placement_;
+        std::vector<Slot> slots_;
+        std::size_t node_count_ = 1;
+
+        // queue i belongs to thread_id i, tables are never freed before
+        // destruction so that a submitter may keep using a stale one
+        std::vector<std::unique_ptr<WorkQueue>> queues_;
+        std::vector<std::unique_ptr<QueueTable>> tables_;
+        std::atomic<const QueueTable*> table_{nullptr};
+
+        // shared rings replacing the deques when the QueuePolicy has a capacity
+        Overflow overflow_ = Overflow::Block;
+        std::array<std::unique_ptr<BoundedQueue<Entry>>, priority_count> rings_;
+        std::atomic<std::size_t> blocked_{0};
+        std::condition_variable room_;
+        std::mutex mutex_room_;
+
+        // blocking lane
+        std::deque<Task> blocking_tasks_;
+        std::vector<std::thread> blocking_threads_;
+        std::size_t blocking_idle_ = 0;
+        std::size_t blocking_budget_ = std::max(std::thread::hardware_concurrency(), 1u);
+        bool blocking_join_ = false;
+        std::condition_variable blocking_wakeup_;
+        mutable std::mutex mutex_blocking_;
+
+        // timers, min heap on due time
+        std::vector<TimerSlot> timers_;
+        std::vector<std::uint32_t> free_timers_;
+        std::vector<TimerDue> timer_heap_;
+        std::thread timer_thread_;
+        bool timer_stop_ = false;
+        std::condition_variable timer_wakeup_;
+        std::mutex mutex_timers_;
+
         std::condition_variable wakeup_;
         std::condition_variable task_completed_;
         std::mutex mutex_wakeup_;
         std::mutex mutex_task_completed_;
+        std::mutex mutex_workers_;
+
+        // held by the thread running a task as worker_count()
+        std::mutex mutex_assist_;
 };
 
-template <class Fn, class... Args>
-auto ThreadPool::arun(Fn&& fn, Args&&... args) -> std::future<decltype(fn(std::size_t{}, args...))> {
-    using return_type = typename std::result_of<Fn(std::size_t, Args...)>::type;
+/**
+ * Set of tasks submitted to a ThreadPool that can be waited for on its own,
+ * regardless of other work running in the pool.
+ * The group holds a token of its own on its counter so that the last task to
+ * complete knows a waiter is blocked and is the only one to wake it.
+ * A group may be reused once waited for, it is waited for on destruction.
+ */
+class TaskGroup {
+    public:
+        /**
+         * Tasks of the group are queued with the given priority. With a
+         * token, those not started once it is cancelled are dropped.
+         */
+        explicit TaskGroup(ThreadPool&, ThreadPool::Priority = ThreadPool::Priority::Normal);
+        TaskGroup(ThreadPool&, CancelToken, ThreadPool::Priority = ThreadPool::Priority::Normal);
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        /**
+         * Submit fn(thread_id) to the pool. May be called from a task of the
+         * group itself.
+         */
+        template <typename Fn>
+        void run(Fn&& fn);
+
+        /**
+         * Submit count tasks calling fn(thread_id, i) for i in [0, count) in
+         * one go, each holding its own copy of fn.
+         */
+        template <typename Fn>
+        void run_n(std::size_t count, Fn&& fn);
+
+        /**
+         * Run pool tasks until the group's tasks are all taken, then block
+         * until they complete. Rethrow the first exception one of them threw,
+         * Cancelled if one was dropped.
+         */
+        void wait();
+
+    private:
+        /**
+         * Held by each task of the group. Completes the group as the task
+         * runs, or as it is destroyed without having run.
+         */
+        class Ticket {
+            public:
+                explicit Ticket(TaskGroup* group) :
+                    group_{group} {}
+
+                Ticket(Ticket&& other) noexcept :
+                    group_{std::exchange(other.group_, nullptr)} {}
+
+                Ticket& operator=(Ticket&&) = delete;
+
+                ~Ticket() {
+                    if (group_) {
+                        group_->fail(std::make_exception_ptr(Cancelled{}));
+                        group_->complete();
+                    }
+                }
+
+                template <typename Fn>
+                void run(Fn&& fn);
 
-    auto task = std::make_shared<std::packaged_task<return_type(std::size_t)>>(
-        std::bind(std::forward<Fn>(fn),
-                  std::placeholders::_1,
-                  std::forward<Args>(args)...)
-        );
+            private:
+                TaskGroup* group_;
+        };
 
-    std::future<return_type> res = task->get_future();
+        // how often a waiter that could not help checks back
+        static constexpr std::chrono::microseconds assist_retry{200};
 
-    {
-        std::unique_lock<std::mutex> lock(mutex_wakeup_);
+        void fail(std::exception_ptr);
+        void complete(std::size_t = 1);
 
-        if ( ! join_) {
-            queue_.emplace([task](std::size_t thread_id){ (*task)(thread_id); });
-            wakeup_.notify_one();
+        ThreadPool& pool_;
+        ThreadPool::Priority priority_;
+        std::optional<CancelToken> token_;
+        std::atomic<std::size_t> pending_{1};
+        bool done_ = false;
+        std::exception_ptr exception_;
+        std::mutex mutex_;
+        std::condition_variable completed_;
+};
+
+template <typename Fn>
+void TaskGroup::Ticket::run(Fn&& fn) {
+    TaskGroup* group = std::exchange(group_, nullptr);
+
+    if (group->token_ && group->token_->cancelled()) {
+        group->fail(std::make_exception_ptr(Cancelled{}));
+    }
+    else {
+        try {
+            std::forward<Fn>(fn)();
+        }
+        catch (...) {
+            group->fail(std::current_exception());
         }
     }
 
+    group->complete();
+}
+
+template <typename Fn>
+void TaskGroup::run(Fn&& fn) {
+    ++ pending_;
+
+    // a task the pool refuses completes as its ticket is destroyed
+    pool_.push([ticket = Ticket{this}, fn = std::forward<Fn>(fn)](std::size_t thread_id) mutable {
+        ticket.run([&] { fn(thread_id); });
+    }, priority_);
+}
+
+template <typename Fn>
+void TaskGroup::run_n(std::size_t count, Fn&& fn) {
+    pending_ += count;
+
+    auto make = [this, &fn](std::size_t i) -> Task {
+        return [ticket = Ticket{this}, fn, i](std::size_t thread_id) mutable {
+            ticket.run([&] { fn(thread_id, i); });
+        };
+    };
+
+    if ( ! pool_.push_n(count, &ThreadPool::make_task<decltype(make)>, &make, priority_)) {
+        fail(std::make_exception_ptr(Cancelled{}));
+        complete(count);
+    }
+}
+
+template <typename Make>
+Task ThreadPool::make_task(void* make, std::size_t i) {
+    return (*static_cast<Make*>(make))(i);
+}
+
+template <class Fn, class... Args>
+auto ThreadPool::arun(Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))> {
+    return arun(Priority::Normal, std::forward<Fn>(fn), std::forward<Args>(args)...);
+}
+
+namespace detail {
+
+/**
+ * Task fulfilling promise with fn(thread_id, args...).
+ */
+template <typename R, typename Fn, typename... Args>
+auto promised(Promise<R>&& promise, Fn&& fn, Args&&... args) {
+    return [promise = std::move(promise),
+            fn = std::forward<Fn>(fn),
+            args = std::make_tuple(std::forward<Args>(args)...)](std::size_t thread_id) mutable {
+        fulfill(promise, [&]() -> R {
+            return std::apply([&](auto&... as) -> R { return fn(thread_id, as...); }, args);
+        });
+    };
+}
+
+} // namespace detail
+
+template <class Fn, class... Args>
+auto ThreadPool::arun(Priority priority, Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))> {
+    using return_type = decltype(fn(std::size_t{}, args...));
+
+    Promise<return_type> promise;
+    Future<return_type> res = promise.get_future();
+
+    push(detail::promised(std::move(promise), std::forward<Fn>(fn), std::forward<Args>(args)...), priority);
+
+    return res;
+}
+
+template <class Fn, class... Args>
+auto ThreadPool::arun(const CancelToken& token, Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))> {
+    return arun(token, Priority::Normal, std::forward<Fn>(fn), std::forward<Args>(args)...);
+}
+
+template <class Fn, class... Args>
+auto ThreadPool::arun(const CancelToken& token, Priority priority, Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))> {
+    using return_type = decltype(fn(std::size_t{}, args...));
+
+    Promise<return_type> promise;
+    Future<return_type> res = promise.get_future();
+
+    push([promise = std::move(promise),
+          token,
+          fn = std::forward<Fn>(fn),
+          args = std::make_tuple(std::forward<Args>(args)...)](std::size_t thread_id) mutable {
+        if (token.cancelled()) {
+            promise.set_exception(std::make_exception_ptr(Cancelled{}));
+            return;
+        }
+
+        detail::fulfill(promise, [&]() -> return_type {
+            return std::apply([&](auto&... as) -> return_type { return fn(thread_id, as...); }, args);
+        });
+    }, priority);
+
     return res;
 }
 
+template <class Fn, class... Args>
+auto ThreadPool::arun_blocking(Fn&& fn, Args&&... args) -> Future<decltype(fn(std::size_t{}, args...))> {
+    using return_type = decltype(fn(std::size_t{}, args...));
+
+    Promise<return_type> promise;
+    Future<return_type> res = promise.get_future();
+
+    push_blocking(detail::promised(std::move(promise), std::forward<Fn>(fn), std::forward<Args>(args)...));
+
+    return res;
+}
+
+template <class Fn>
+void ThreadPool::post_n(std::size_t count, Fn&& fn) {
+    auto make = [&fn](std::size_t i) -> Task {
+        return [fn, i](std::size_t thread_id) mutable {
+            try {
+                fn(thread_id, i);
+            }
+            catch (...) {
+                // fire and forget
+            }
+        };
+    };
+
+    push_n(count, &make_task<decltype(make)>, &make);
+}
+
+template <class Fn>
+ThreadPool::TimerId ThreadPool::run_at(Clock::time_point time, Fn&& fn) {
+    return add_timer(time, Clock::duration::zero(), std::forward<Fn>(fn));
+}
+
+template <class Fn>
+ThreadPool::TimerId ThreadPool::run_after(Clock::duration delay, Fn&& fn) {
+    return add_timer(Clock::now() + delay, Clock::duration::zero(), std::forward<Fn>(fn));
+}
+
+template <class Fn>
+ThreadPool::TimerId ThreadPool::run_every(Clock::duration period, Fn&& fn) {
+    // a zero period would fire in a loop
+    period = std::max(period, Clock::duration{1});
+
+    return add_timer(Clock::now() + period, period, std::forward<Fn>(fn));
+}
+
 template <class Fn, class... Args>
 auto ThreadPool::run(Fn&& fn, Args&&... args) -> decltype(fn(std::size_t{}, args...)) {
     auto res = arun(std::forward<Fn>(fn), std::forward<Args>(args)...);
@@ -81,24 +893,156 @@ auto ThreadPool::run(Fn&& fn, Args&&... args) -> decltype(fn(std::size_t{}, args
     return res.get();
 }
 
+/**
+ * How split_for distributes indices between tasks.
+ */
+enum class Schedule {
+    Static,     // split batches of at least at_least indices, cut ahead of time
+    Dynamic,    // split tasks claiming chunks of at_least indices from a shared cursor
+    Guided      // like Dynamic, chunks of remaining / split indices, at least at_least
+};
+
+namespace detail {
+
+/**
+ * split_for, checking token if any before each chunk of at_least indices.
+ * Return false if indices were left out as the token got cancelled.
+ */
 template <typename Fn>
-void split_for(ThreadPool& pool,
+bool split_for(ThreadPool& pool,
                std::size_t count, std::size_t stride, std::size_t split, std::size_t at_least,
-               Fn&& fn) {
-    std::size_t batch = std::max((count / split) + ((count % split) ? 1 : 0), at_least);
+               Schedule schedule, const CancelToken* token, Fn&& fn) {
+    if (count == 0) {
+        return true;
+    }
 
-    for (std::size_t i{0}; i < count; i += batch) {
-        std::size_t sub_count = stride * std::min(i + batch, count);
+    TaskGroup group(pool);
 
-        pool.arun([&fn, i, sub_count, stride](std::size_t thread_id) {
-            for (std::size_t j = i * stride; j < sub_count; j += stride) {
-                fn(thread_id, j);
+    // every schedule runs all indices in a single task when asked for none
+    split = std::max<std::size_t>(split, 1);
+
+    const std::size_t chunk = std::max<std::size_t>(at_least, 1);
+
+    std::atomic<bool> stopped{false};
+
+    auto stop = [token, &stopped] {
+        if (token && token->cancelled()) {
+            stopped.store(true, std::memory_order_relaxed);
+            return true;
+        }
+
+        return false;
+    };
+
+    if (schedule == Schedule::Static) {
+        std::size_t batch = std::max((count / split) + ((count % split) ? 1 : 0), at_least);
+
+        // without a token a batch is a single chunk
+        const std::size_t step = token ? chunk : batch;
+
+        auto run_batch = [&fn, &stop, count, stride, batch, step](std::size_t thread_id, std::size_t b) {
+            const std::size_t last = std::min((b + 1) * batch, count);
+
+            for (std::size_t begin = b * batch; begin < last; begin += step) {
+                if (stop()) {
+                    return;
+                }
+
+                const std::size_t sub_count = stride * std::min(begin + step, last);
+
+                for (std::size_t j = begin * stride; j < sub_count; j += stride) {
+                    fn(thread_id, j);
+                }
             }
+        };
+
+        // tasks only hold a reference, small enough for Task's inline storage
+        group.run_n((count + batch - 1) / batch, [&run_batch](std::size_t thread_id, std::size_t b) {
+            run_batch(thread_id, b);
         });
+
+        group.wait();
+
+        return ! stopped.load(std::memory_order_relaxed);
     }
 
-    pool.assist();
-    pool.wait_completion();
+    const std::size_t tasks = std::min(split, (count + chunk - 1) / chunk);
+
+    alignas(64) std::atomic<std::size_t> cursor{0};
+
+    // claim [begin, end) of the remaining indices, false once there are none
+    auto claim = [&cursor, count, split, chunk, schedule](std::size_t& begin, std::size_t& end) {
+        if (schedule == Schedule::Dynamic) {
+            begin = cursor.fetch_add(chunk, std::memory_order_relaxed);
+            end = std::min(begin + chunk, count);
+
+            return begin < count;
+        }
+
+        begin = cursor.load(std::memory_order_relaxed);
+
+        do {
+            if (begin >= count) {
+                return false;
+            }
+
+            end = std::min(begin + std::max((count - begin) / split, chunk), count);
+        } while ( ! cursor.compare_exchange_weak(begin, end, std::memory_order_relaxed));
+
+        return true;
+    };
+
+    group.run_n(tasks, [&fn, &claim, &stop, stride](std::size_t thread_id, std::size_t) {
+        std::size_t begin;
+        std::size_t end;
+
+        while (claim(begin, end)) {
+            if (stop()) {
+                return;
+            }
+
+            for (std::size_t j = begin * stride; j < end * stride; j += stride) {
+                fn(thread_id, j);
+            }
+        }
+    });
+
+    group.wait();
+
+    return ! stopped.load(std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+/**
+ * Call fn(thread_id, j) for j = 0, stride, ..., (count - 1) * stride from pool
+ * tasks and the calling thread, return once all calls are done. A split of 0
+ * counts as 1.
+ */
+template <typename Fn>
+void split_for(ThreadPool& pool,
+               std::size_t count, std::size_t stride, std::size_t split, std::size_t at_least,
+               Schedule schedule, Fn&& fn) {
+    detail::split_for(pool, count, stride, split, at_least, schedule, nullptr, std::forward<Fn>(fn));
+}
+
+template <typename Fn>
+void split_for(ThreadPool& pool,
+               std::size_t count, std::size_t stride, std::size_t split, std::size_t at_least,
+               Fn&& fn) {
+    split_for(pool, count, stride, split, at_least, Schedule::Static, std::forward<Fn>(fn));
+}
+
+/**
+ * Same, token being checked before each chunk of at_least indices so that
+ * the remaining ones are skipped once it is cancelled. Return false if some
+ * indices were skipped.
+ */
+template <typename Fn>
+bool split_for(ThreadPool& pool,
+               std::size_t count, std::size_t stride, std::size_t split, std::size_t at_least,
+               Schedule schedule, const CancelToken& token, Fn&& fn) {
+    return detail::split_for(pool, count, stride, split, at_least, schedule, &token, std::forward<Fn>(fn));
 }
 
-} // namespace ee
\ No newline at end of file
+} // namespace ee
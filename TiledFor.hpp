@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace ee {
+
+/**
+ * Half open box [begin, end) of a grid, x first.
+ */
+template <std::size_t N>
+struct Tile {
+    std::array<std::size_t, N> begin;
+    std::array<std::size_t, N> end;
+};
+
+/**
+ * Order in which split_for_2d and split_for_3d hand out tiles. Tiles are
+ * claimed one at a time, so tiles running together are close along the
+ * order, Morton and Hilbert keeping them close in every dimension.
+ */
+enum class TileOrder {
+    RowMajor,
+    Morton,
+    Hilbert
+};
+
+namespace detail {
+
+/**
+ * Bytes a tile should span, about a L1 data cache.
+ */
+constexpr std::size_t tile_bytes = 32 * 1024;
+
+/**
+ * Largest power of two extents of items of item_size bytes fitting
+ * tile_bytes, grown x first.
+ */
+template <std::size_t N>
+std::array<std::size_t, N> cache_tile(std::size_t item_size) {
+    std::array<std::size_t, N> extent;
+    extent.fill(1);
+
+    std::size_t bytes = std::max<std::size_t>(item_size, 1);
+
+    for (std::size_t d = 0; bytes * 2 <= tile_bytes; d = (d + 1) % N) {
+        extent[d] *= 2;
+        bytes *= 2;
+    }
+
+    return extent;
+}
+
+/**
+ * Interleave the low bits of coords, coords[0] taking the most significant
+ * bit of each group.
+ */
+template <std::size_t N>
+std::uint64_t interleave(const std::array<std::uint32_t, N>& coords, unsigned bits) {
+    std::uint64_t key = 0;
+
+    for (unsigned bit = bits; bit -- > 0;) {
+        for (std::size_t d = 0; d < N; ++ d) {
+            key = (key << 1) | ((coords[d] >> bit) & 1u);
+        }
+    }
+
+    return key;
+}
+
+template <std::size_t N>
+std::uint64_t morton_key(std::array<std::uint32_t, N> coords, unsigned bits) {
+    // x least significant
+    std::reverse(coords.begin(), coords.end());
+
+    return interleave(coords, bits);
+}
+
+/**
+ * Distance along the Hilbert curve, from the axes to transpose conversion
+ * of J. Skilling, "Programming the Hilbert curve" (2004).
+ */
+template <std::size_t N>
+std::uint64_t hilbert_key(std::array<std::uint32_t, N> coords, unsigned bits) {
+    const std::uint32_t m = 1u << (bits - 1);
+
+    for (std::uint32_t q = m; q > 1; q >>= 1) {
+        const std::uint32_t p = q - 1;
+
+        for (std::size_t d = 0; d < N; ++ d) {
+            if (coords[d] & q) {
+                coords[0] ^= p;
+            }
+            else {
+                const std::uint32_t t = (coords[0] ^ coords[d]) & p;
+                coords[0] ^= t;
+                coords[d] ^= t;
+            }
+        }
+    }
+
+    for (std::size_t d = 1; d < N; ++ d) {
+        coords[d] ^= coords[d - 1];
+    }
+
+    std::uint32_t t = 0;
+
+    for (std::uint32_t q = m; q > 1; q >>= 1) {
+        if (coords[N - 1] & q) {
+            t ^= q - 1;
+        }
+    }
+
+    for (std::size_t d = 0; d < N; ++ d) {
+        coords[d] ^= t;
+    }
+
+    return interleave(coords, bits);
+}
+
+template <std::size_t N, typename Fn>
+void split_for_tiles(ThreadPool& pool,
+                     const std::array<std::size_t, N>& size, std::array<std::size_t, N> extent,
+                     TileOrder order, Fn&& fn) {
+    std::array<std::size_t, N> tiles;
+    std::size_t count = 1;
+    std::size_t most = 1;
+
+    for (std::size_t d = 0; d < N; ++ d) {
+        extent[d] = std::max<std::size_t>(extent[d], 1);
+        tiles[d] = (size[d] + extent[d] - 1) / extent[d];
+        count *= tiles[d];
+        most = std::max(most, tiles[d]);
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    // tile coordinates from the row-major tile index
+    auto coords_of = [&tiles](std::size_t index) {
+        std::array<std::uint32_t, N> coords;
+
+        for (std::size_t d = 0; d < N; ++ d) {
+            coords[d] = static_cast<std::uint32_t>(index % tiles[d]);
+            index /= tiles[d];
+        }
+
+        return coords;
+    };
+
+    std::vector<std::size_t> sequence;
+
+    if (order != TileOrder::RowMajor) {
+        unsigned bits = 1;
+
+        while ((std::size_t{1} << bits) < most) {
+            ++ bits;
+        }
+
+        std::vector<std::pair<std::uint64_t, std::size_t>> keyed(count);
+
+        for (std::size_t index = 0; index < count; ++ index) {
+            const auto coords = coords_of(index);
+
+            keyed[index] = {order == TileOrder::Morton ? morton_key(coords, bits) : hilbert_key(coords, bits), index};
+        }
+
+        std::sort(keyed.begin(), keyed.end());
+
+        sequence.resize(count);
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            sequence[i] = keyed[i].second;
+        }
+    }
+
+    const std::size_t split = pool.worker_count() + 1;
+
+    split_for(pool, count, 1, split, 1, Schedule::Dynamic, [&](std::size_t thread_id, std::size_t i) {
+        const auto coords = coords_of(sequence.empty() ? i : sequence[i]);
+
+        Tile<N> tile;
+
+        for (std::size_t d = 0; d < N; ++ d) {
+            tile.begin[d] = coords[d] * extent[d];
+            tile.end[d] = std::min(tile.begin[d] + extent[d], size[d]);
+        }
+
+        fn(thread_id, static_cast<const Tile<N>&>(tile));
+    });
+}
+
+} // namespace detail
+
+/**
+ * Call fn(thread_id, tile) for tiles of tile_width x tile_height covering a
+ * width x height grid, from pool tasks and the calling thread, return once all
+ * calls are done.
+ */
+template <typename Fn>
+void split_for_2d(ThreadPool& pool,
+                  std::size_t width, std::size_t height,
+                  std::size_t tile_width, std::size_t tile_height,
+                  TileOrder order, Fn&& fn) {
+    detail::split_for_tiles<2>(pool, {width, height}, {tile_width, tile_height}, order, std::forward<Fn>(fn));
+}
+
+/**
+ * Same with tiles of items of item_size bytes sized to stay in cache, in
+ * Morton order.
+ */
+template <typename Fn>
+void split_for_2d(ThreadPool& pool, std::size_t width, std::size_t height, std::size_t item_size, Fn&& fn) {
+    detail::split_for_tiles<2>(pool, {width, height}, detail::cache_tile<2>(item_size),
+                               TileOrder::Morton, std::forward<Fn>(fn));
+}
+
+/**
+ * Call fn(thread_id, tile) for tiles of tile_width x tile_height x tile_depth
+ * covering a width x height x depth grid, from pool tasks and the calling
+ * thread, return once all calls are done.
+ */
+template <typename Fn>
+void split_for_3d(ThreadPool& pool,
+                  std::size_t width, std::size_t height, std::size_t depth,
+                  std::size_t tile_width, std::size_t tile_height, std::size_t tile_depth,
+                  TileOrder order, Fn&& fn) {
+    detail::split_for_tiles<3>(pool, {width, height, depth}, {tile_width, tile_height, tile_depth},
+                               order, std::forward<Fn>(fn));
+}
+
+/**
+ * Same with tiles of items of item_size bytes sized to stay in cache, in
+ * Morton order.
+ */
+template <typename Fn>
+void split_for_3d(ThreadPool& pool,
+                  std::size_t width, std::size_t height, std::size_t depth, std::size_t item_size,
+                  Fn&& fn) {
+    detail::split_for_tiles<3>(pool, {width, height, depth}, detail::cache_tile<3>(item_size),
+                               TileOrder::Morton, std::forward<Fn>(fn));
+}
+
+} // namespace ee
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace ee {
+
+/**
+ * One T per thread_id of a pool, worker_count() + 1 including the assisting
+ * thread, each on cache lines of its own.
+ *
+ * Slots are sized once from worker_count() at construction, rebuild after
+ * spawn(). Other thread_ids, blocking_thread_id included, throw
+ * std::out_of_range. A thread_id having one user at a time, each slot is
+ * only touched by one thread at a time.
+ */
+template <typename T>
+class WorkerLocal {
+    public:
+        template <typename... Args>
+        explicit WorkerLocal(const ThreadPool& pool, const Args&... args) {
+            slots_.reserve(pool.worker_count() + 1);
+
+            for (std::size_t i = 0; i <= pool.worker_count(); ++ i) {
+                slots_.push_back(Slot{T(args...)});
+            }
+        }
+
+        T& operator[](std::size_t thread_id) {
+            if (thread_id >= slots_.size()) {
+                throw std::out_of_range("thread_id past the workers the slots were sized for");
+            }
+
+            return slots_[thread_id].value;
+        }
+
+        const T& operator[](std::size_t thread_id) const {
+            if (thread_id >= slots_.size()) {
+                throw std::out_of_range("thread_id past the workers the slots were sized for");
+            }
+
+            return slots_[thread_id].value;
+        }
+
+        std::size_t size() const {
+            return slots_.size();
+        }
+
+        /**
+         * Assign value to every slot, keeping whatever storage T holds.
+         */
+        void reset(const T& value = T{}) {
+            for (Slot& slot : slots_) {
+                slot.value = value;
+            }
+        }
+
+        template <typename Fn>
+        void for_each(Fn&& fn) {
+            for (Slot& slot : slots_) {
+                fn(slot.value);
+            }
+        }
+
+        /**
+         * Fold every slot into init with op(init, value).
+         */
+        template <typename R, typename Op>
+        R combine(R init, Op&& op) const {
+            for (const Slot& slot : slots_) {
+                init = op(std::move(init), slot.value);
+            }
+
+            return init;
+        }
+
+    private:
+        struct alignas(std::max(Arena::cache_line, alignof(T))) Slot {
+            T value;
+        };
+
+        std::vector<Slot> slots_;
+};
+
+} // namespace ee
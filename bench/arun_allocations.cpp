@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * Count heap allocations made per ThreadPool::arun in the steady state.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../ThreadPool.hpp"
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    ++ allocations;
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+template <typename Fn>
+double allocations_per_call(std::size_t count, Fn&& fn) {
+    const std::size_t before = allocations;
+
+    for (std::size_t i = 0; i < count; ++ i) {
+        fn(i);
+    }
+
+    return static_cast<double>(allocations - before) / count;
+}
+
+} // namespace
+
+int main() {
+    constexpr std::size_t warmup = 10000;
+    constexpr std::size_t count = 100000;
+
+    ee::ThreadPool pool(std::thread::hardware_concurrency());
+
+    int value = 0;
+
+    auto arun_get = [&](std::size_t i) {
+        value += pool.arun([i](std::size_t thread_id) { return static_cast<int>(i + thread_id); }).get();
+    };
+
+    auto arun_args = [&](std::size_t i) {
+        pool.arun([](std::size_t, std::size_t a, double b) { return a * b; }, i, 0.5).get();
+    };
+
+    auto arun_batch = [&](std::size_t) {
+        ee::Future<void> futures[64];
+
+        for (auto& future : futures) {
+            future = pool.arun([&value](std::size_t) { (void) value; });
+        }
+
+        for (auto& future : futures) {
+            future.get();
+        }
+    };
+
+    allocations_per_call(warmup, arun_get);
+    std::printf("arun + get, small lambda:      %.3f allocations per arun\n",
+                allocations_per_call(count, arun_get));
+
+    allocations_per_call(warmup, arun_args);
+    std::printf("arun + get, bound arguments:   %.3f allocations per arun\n",
+                allocations_per_call(count, arun_args));
+
+    allocations_per_call(warmup / 64, arun_batch);
+    std::printf("64 arun then 64 get:           %.3f allocations per arun\n",
+                allocations_per_call(count / 64, arun_batch) / 64);
+
+    return value == -1;
+}
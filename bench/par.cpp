@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * Compare ee::par algorithms against their serial std counterparts.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "../parallel.hpp"
+
+namespace {
+
+template <typename Fn>
+double best_ms(Fn&& fn) {
+    double best = 0.;
+
+    for (int run = 0; run < 5; ++ run) {
+        const auto start = std::chrono::steady_clock::now();
+
+        fn();
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    return best;
+}
+
+void report(const char* name, double serial, double parallel) {
+    std::printf("%-18s std %9.3f ms  par %9.3f ms  x%.2f\n", name, serial, parallel, serial / parallel);
+}
+
+} // namespace
+
+int main() {
+    constexpr std::size_t count = 1 << 24;
+
+    ee::ThreadPool pool;
+
+    std::vector<double> input(count);
+    std::vector<double> output(count);
+    std::mt19937_64 rng{42};
+    std::uniform_real_distribution<double> distribution{0., 1.};
+
+    for (auto& value : input) {
+        value = distribution(rng);
+    }
+
+    std::printf("%zu doubles, %zu workers\n", count, pool.worker_count());
+
+    volatile double sink = 0.;
+
+    report("reduce",
+        best_ms([&] { sink = std::reduce(input.begin(), input.end(), 0.); }),
+        best_ms([&] { sink = ee::par::reduce(pool, input.begin(), input.end(), 0.); }));
+
+    const auto square = [](double value) { return value * value; };
+
+    report("transform_reduce",
+        best_ms([&] { sink = std::transform_reduce(input.begin(), input.end(), 0., std::plus<>{}, square); }),
+        best_ms([&] { sink = ee::par::transform_reduce(pool, input.begin(), input.end(), 0., std::plus<>{}, square); }));
+
+    report("inclusive_scan",
+        best_ms([&] { std::inclusive_scan(input.begin(), input.end(), output.begin()); }),
+        best_ms([&] { ee::par::inclusive_scan(pool, input.begin(), input.end(), output.begin()); }));
+
+    report("exclusive_scan",
+        best_ms([&] { std::exclusive_scan(input.begin(), input.end(), output.begin(), 0.); }),
+        best_ms([&] { ee::par::exclusive_scan(pool, input.begin(), input.end(), output.begin(), 0.); }));
+
+    const auto half = [](double value) { return value < .5; };
+
+    report("partition",
+        best_ms([&] { output = input; std::stable_partition(output.begin(), output.end(), half); }),
+        best_ms([&] { output = input; ee::par::partition(pool, output.begin(), output.end(), half); }));
+
+    report("for_each",
+        best_ms([&] { std::for_each(output.begin(), output.end(), [](double& value) { value = std::sqrt(value); }); }),
+        best_ms([&] { ee::par::for_each(pool, output.begin(), output.end(), [](double& value) { value = std::sqrt(value); }); }));
+
+    report("sort",
+        best_ms([&] { output = input; std::sort(output.begin(), output.end()); }),
+        best_ms([&] { output = input; ee::par::sort(pool, output.begin(), output.end()); }));
+
+    (void) sink;
+}
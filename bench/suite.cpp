@@ -0,0 +1,562 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * Benchmark suite for ThreadPool, split_for and cwise, results are written as
+ * JSON to compare them across commits.
+ *
+ *   ee_bench_suite [--json file] [--threads max] [--quick]
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ThreadPool.hpp"
+#include "../componentwise.hpp"
+#include "../parallel.hpp"
+
+#if ! defined(EE_BENCH_REVISION)
+#define EE_BENCH_REVISION "unknown"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    std::size_t threads;
+    double value;
+    const char* unit;
+};
+
+struct Options {
+    std::size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string json;
+    bool quick = false;
+};
+
+std::vector<Result> results;
+Options options;
+
+void report(std::string name, std::size_t threads, double value, const char* unit) {
+    std::printf("%-40s %3zu threads %14.3f %s\n", name.c_str(), threads, value, unit);
+    results.push_back({std::move(name), threads, value, unit});
+}
+
+double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/**
+ * Best time of a few runs of fn, in nanoseconds.
+ */
+template <typename Fn>
+double best_ns(Fn&& fn) {
+    const int runs = options.quick ? 2 : 5;
+    double best = 0.;
+
+    for (int run = 0; run < runs; ++ run) {
+        const auto start = Clock::now();
+
+        fn();
+
+        const double ns = elapsed_ns(start);
+
+        if (run == 0 || ns < best) {
+            best = ns;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * 1, 2, 4, ... up to max_threads, max_threads included.
+ */
+std::vector<std::size_t> thread_counts() {
+    std::vector<std::size_t> counts;
+
+    for (std::size_t threads = 1; threads < options.max_threads; threads *= 2) {
+        counts.push_back(threads);
+    }
+
+    counts.push_back(options.max_threads);
+
+    return counts;
+}
+
+/**
+ * Keep the optimizer from dropping a computation.
+ */
+template <typename T>
+void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+void spin(std::size_t iterations) {
+    for (std::size_t i = 0; i < iterations; ++ i) {
+        keep(i);
+    }
+}
+
+void empty_tasks() {
+    const std::size_t count = options.quick ? 20000 : 200000;
+
+    for (std::size_t threads : thread_counts()) {
+        ee::ThreadPool pool(threads);
+
+        const double post_n = best_ns([&] {
+            pool.post_n(count, [](std::size_t, std::size_t) {});
+            pool.wait_completion();
+        });
+
+        report("empty_task_throughput/post_n", threads, count / post_n * 1e3, "Mtasks/s");
+
+        const double arun = best_ns([&] {
+            for (std::size_t i = 0; i < count; ++ i) {
+                pool.arun([](std::size_t) {});
+            }
+
+            pool.wait_completion();
+        });
+
+        report("empty_task_throughput/arun", threads, count / arun * 1e3, "Mtasks/s");
+    }
+}
+
+void start_latency() {
+    const std::size_t count = options.quick ? 1000 : 10000;
+
+    for (std::size_t threads : thread_counts()) {
+        ee::ThreadPool pool(threads);
+        std::vector<double> latencies;
+
+        latencies.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            const auto submitted = Clock::now();
+
+            latencies.push_back(pool.arun([submitted](std::size_t) {
+                return std::chrono::duration<double, std::nano>(Clock::now() - submitted).count();
+            }).get());
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+
+        report("arun_start_latency/p50", threads, latencies[count / 2], "ns");
+        report("arun_start_latency/p99", threads, latencies[count * 99 / 100], "ns");
+    }
+}
+
+void split_for_scaling() {
+    const std::size_t count = options.quick ? 1 << 12 : 1 << 15;
+    const std::size_t work = 200;
+
+    struct Load {
+        const char* name;
+        std::function<std::size_t(std::size_t)> iterations;
+    };
+
+    const Load loads[] = {
+        {"balanced", [work](std::size_t) { return work; }},
+        // most of the work in the last indices
+        {"skewed", [work, count](std::size_t j) { return 2 * work * j * j / (count * count / 2 + 1); }}
+    };
+
+    const std::pair<const char*, ee::Schedule> schedules[] = {
+        {"static", ee::Schedule::Static},
+        {"dynamic", ee::Schedule::Dynamic},
+        {"guided", ee::Schedule::Guided}
+    };
+
+    for (const Load& load : loads) {
+        for (const auto& schedule : schedules) {
+            double single = 0.;
+
+            for (std::size_t threads : thread_counts()) {
+                // the calling thread takes part
+                ee::ThreadPool pool(threads - 1);
+
+                const double ns = best_ns([&] {
+                    ee::split_for(pool, count, 1, threads * 4, 16, schedule.second, [&](std::size_t, std::size_t j) {
+                        spin(load.iterations(j));
+                    });
+                });
+
+                if (threads == 1) {
+                    single = ns;
+                }
+
+                const std::string name = std::string("split_for/") + load.name + "/" + schedule.first;
+
+                report(name + "/time", threads, ns / 1e6, "ms");
+                report(name + "/speedup", threads, single / ns, "x");
+            }
+        }
+    }
+}
+
+void wait_completion_contention() {
+    const std::size_t rounds = options.quick ? 200 : 2000;
+
+    for (std::size_t threads : thread_counts()) {
+        ee::ThreadPool pool(std::max<std::size_t>(options.max_threads / 2, 1));
+        std::vector<std::thread> waiters;
+        std::atomic<bool> go{false};
+
+        for (std::size_t t = 0; t < threads; ++ t) {
+            waiters.emplace_back([&] {
+                while ( ! go) {
+                    std::this_thread::yield();
+                }
+
+                for (std::size_t i = 0; i < rounds; ++ i) {
+                    pool.arun([](std::size_t) { spin(100); });
+                    pool.wait_completion();
+                }
+            });
+        }
+
+        const auto start = Clock::now();
+
+        go = true;
+
+        for (auto& waiter : waiters) {
+            waiter.join();
+        }
+
+        report("wait_completion/waiters", threads, threads * rounds / elapsed_ns(start) * 1e3, "Mwaits/s");
+    }
+}
+
+template <typename T, std::size_t N>
+using Vec = std::array<T, N>;
+
+template <std::size_t N>
+void cwise_against_loops(const char* name) {
+    const std::size_t count = options.quick ? 1 << 14 : 1 << 18;
+
+    std::vector<Vec<float, N>> a(count);
+    std::vector<Vec<float, N>> b(count);
+    std::vector<Vec<float, N>> c(count);
+
+    for (std::size_t i = 0; i < count; ++ i) {
+        for (std::size_t k = 0; k < N; ++ k) {
+            a[i][k] = static_cast<float>(i + k);
+            b[i][k] = static_cast<float>(i * k) * .5f;
+        }
+    }
+
+    const double cwise_add = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            c[i] = ee::cwise(std::plus<>{}, a[i], b[i]);
+        }
+
+        keep(c);
+    });
+
+    const double loop_add = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            for (std::size_t k = 0; k < N; ++ k) {
+                c[i][k] = a[i][k] + b[i][k];
+            }
+        }
+
+        keep(c);
+    });
+
+    const auto madd = [](float x, float y, float z) { return x * y + z; };
+
+    const double cwise_madd = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            c[i] = ee::cwise(madd, a[i], b[i], c[i]);
+        }
+
+        keep(c);
+    });
+
+    const double lazy_madd = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            c[i] = ee::cwise_lazy(std::plus<>{}, ee::cwise_lazy(std::multiplies<>{}, a[i], b[i]), c[i]);
+        }
+
+        keep(c);
+    });
+
+    const double loop_madd = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            for (std::size_t k = 0; k < N; ++ k) {
+                c[i][k] = a[i][k] * b[i][k] + c[i][k];
+            }
+        }
+
+        keep(c);
+    });
+
+    const double cwise_scale = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            c[i] = ee::cwise(std::multiplies<>{}, a[i], 3.f);
+        }
+
+        keep(c);
+    });
+
+    const double loop_scale = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            for (std::size_t k = 0; k < N; ++ k) {
+                c[i][k] = a[i][k] * 3.f;
+            }
+        }
+
+        keep(c);
+    });
+
+    const double cwise_min = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            c[i] = ee::cwise(ee::ops::min{}, a[i], b[i]);
+        }
+
+        keep(c);
+    });
+
+    const double loop_min = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            for (std::size_t k = 0; k < N; ++ k) {
+                c[i][k] = std::min(a[i][k], b[i][k]);
+            }
+        }
+
+        keep(c);
+    });
+
+    std::vector<float> d(count);
+
+    const double cwise_dot = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            d[i] = ee::dot(a[i], b[i]);
+        }
+
+        keep(d);
+    });
+
+    const double loop_dot = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            float sum = 0.f;
+
+            for (std::size_t k = 0; k < N; ++ k) {
+                sum += a[i][k] * b[i][k];
+            }
+
+            d[i] = sum;
+        }
+
+        keep(d);
+    });
+
+    const std::string prefix = std::string("cwise/") + name;
+
+    report(prefix + "/add/cwise", 1, cwise_add / count, "ns/elem");
+    report(prefix + "/add/loop", 1, loop_add / count, "ns/elem");
+    report(prefix + "/madd/cwise", 1, cwise_madd / count, "ns/elem");
+    report(prefix + "/madd/lazy", 1, lazy_madd / count, "ns/elem");
+    report(prefix + "/madd/loop", 1, loop_madd / count, "ns/elem");
+    report(prefix + "/scale/cwise", 1, cwise_scale / count, "ns/elem");
+    report(prefix + "/scale/loop", 1, loop_scale / count, "ns/elem");
+    report(prefix + "/min/cwise", 1, cwise_min / count, "ns/elem");
+    report(prefix + "/min/loop", 1, loop_min / count, "ns/elem");
+    report(prefix + "/dot/cwise", 1, cwise_dot / count, "ns/elem");
+    report(prefix + "/dot/loop", 1, loop_dot / count, "ns/elem");
+}
+
+/**
+ * Large state blocks updated in place against a = cwise(op, a, b).
+ */
+void cwise_in_place() {
+    using Block = std::array<double, 64>;
+
+    const std::size_t count = options.quick ? 1 << 10 : 1 << 14;
+
+    std::vector<Block> a(count);
+    std::vector<Block> b(count);
+
+    for (std::size_t i = 0; i < count; ++ i) {
+        for (std::size_t k = 0; k < 64; ++ k) {
+            a[i][k] = static_cast<double>(k);
+            b[i][k] = static_cast<double>(i) * 1e-9;
+        }
+    }
+
+    const double copy = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            a[i] = ee::cwise(std::plus<>{}, a[i], b[i]);
+        }
+
+        keep(a);
+    });
+
+    const double assign = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            ee::add_assign(a[i], b[i]);
+        }
+
+        keep(a);
+    });
+
+    const double loop = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            for (std::size_t k = 0; k < 64; ++ k) {
+                a[i][k] += b[i][k];
+            }
+        }
+
+        keep(a);
+    });
+
+    report("cwise/double64/add/cwise", 1, copy / count, "ns/block");
+    report("cwise/double64/add/assign", 1, assign / count, "ns/block");
+    report("cwise/double64/add/loop", 1, loop / count, "ns/block");
+}
+
+/**
+ * a * s + b over large arrays of float4, cwise called per element against
+ * cwise_batch and its parallel form.
+ */
+void cwise_batches() {
+    using Float4 = std::array<float, 4>;
+
+    const std::size_t count = options.quick ? 1 << 16 : 1 << 20;
+    const float s = 1.0001f;
+
+    std::vector<Float4> a(count);
+    std::vector<Float4> b(count);
+    std::vector<Float4> r(count);
+
+    for (std::size_t i = 0; i < count; ++ i) {
+        for (std::size_t k = 0; k < 4; ++ k) {
+            a[i][k] = static_cast<float>(i + k);
+            b[i][k] = static_cast<float>(k) * 0.5f;
+        }
+    }
+
+    const auto madd = [s](float x, float y) { return x * s + y; };
+
+    const double element = best_ns([&] {
+        for (std::size_t i = 0; i < count; ++ i) {
+            r[i] = ee::cwise(madd, a[i], b[i]);
+        }
+
+        keep(r);
+    });
+
+    const double batch = best_ns([&] {
+        ee::cwise_batch(madd, r, a, b);
+        keep(r);
+    });
+
+    report("cwise/float4/batch/element", 1, element / count, "ns/element");
+    report("cwise/float4/batch/batch", 1, batch / count, "ns/element");
+
+    for (std::size_t threads : thread_counts()) {
+        if (threads == 1) {
+            continue;
+        }
+
+        ee::ThreadPool pool(threads - 1);
+
+        const double par_batch = best_ns([&] {
+            ee::par::cwise_batch(pool, madd, r, a, b);
+            keep(r);
+        });
+
+        report("cwise/float4/batch/par_batch", threads, par_batch / count, "ns/element");
+    }
+}
+
+void write_json(std::ostream& out) {
+    out << "{\n"
+        << "  \"suite\": \"ee_utils\",\n"
+        << "  \"revision\": \"" << EE_BENCH_REVISION << "\",\n"
+        << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"quick\": " << (options.quick ? "true" : "false") << ",\n"
+        << "  \"results\": [";
+
+    for (std::size_t i = 0; i < results.size(); ++ i) {
+        const Result& result = results[i];
+
+        out << (i ? ",\n" : "\n")
+            << "    {\"name\": \"" << result.name
+            << "\", \"threads\": " << result.threads
+            << ", \"value\": " << result.value
+            << ", \"unit\": \"" << result.unit << "\"}";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+bool parse(int argc, char** argv) {
+    for (int i = 1; i < argc; ++ i) {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            options.json = argv[++ i];
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.max_threads = std::max(std::stoul(argv[++ i]), 1ul);
+        }
+        else if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        }
+        else {
+            std::fprintf(stderr, "usage: %s [--json file] [--threads max] [--quick]\n", argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if ( ! parse(argc, argv)) {
+        return 1;
+    }
+
+    empty_tasks();
+    start_latency();
+    split_for_scaling();
+    wait_completion_contention();
+    cwise_against_loops<3>("float3");
+    cwise_against_loops<4>("float4");
+    cwise_in_place();
+    cwise_batches();
+
+    if ( ! options.json.empty()) {
+        std::ofstream file(options.json);
+
+        if ( ! file) {
+            std::fprintf(stderr, "cannot write %s\n", options.json.c_str());
+            return 1;
+        }
+
+        write_json(file);
+    }
+    else {
+        write_json(std::cout);
+    }
+
+    return 0;
+}
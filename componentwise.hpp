@@ -7,8 +7,17 @@
 
 #pragma once
 
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
+#include "Span.hpp"
+#include "simd.hpp"
 #include "templates.hpp"
 
 namespace ee {
@@ -104,6 +113,38 @@ struct find_first_tuple_impl<true, F, Ts...> {
 template <typename... Ts>
 using find_first_tuple = typename detail::find_first_tuple_impl<false, void, Ts...>::type;
 
+/**
+ * Function objects completing the standard ones, cwise vectorizes them as it
+ * does std::plus, minus, multiplies, divides and the comparisons.
+ */
+namespace ops {
+
+// b < a ? b : a, as std::min
+struct min {
+    template <typename T>
+    constexpr T operator()(const T& a, const T& b) const {
+        return b < a ? b : a;
+    }
+};
+
+// a < b ? b : a, as std::max
+struct max {
+    template <typename T>
+    constexpr T operator()(const T& a, const T& b) const {
+        return a < b ? b : a;
+    }
+};
+
+// a * b + c rounded once, as std::fma
+struct fma {
+    template <typename T>
+    T operator()(const T& a, const T& b, const T& c) const noexcept {
+        return std::fma(a, b, c);
+    }
+};
+
+} // namespace ops
+
 /**
  * Allow calling functions componentwise.
  */
@@ -117,69 +158,267 @@ but_t<find_first_tuple<Ts...>, std::decay_t<std::invoke_result_t<Fn, find_value_
 // tuple
 template <typename Fn, typename T1, std::size_t... Is>
 constexpr eif<is_tuple<T1>, cwise_return<Fn, T1>> cwise(Fn&& fn, T1&& t1, std::index_sequence<Is...>) {
-    return {std::invoke(fn, t1[Is])...};
+    return {tutil::invoke(fn, t1[Is])...};
 }
 
 /* 2 parameters */
 // tuple, tuple
 template <typename Fn, typename T1, typename T2, std::size_t... Is>
 constexpr eif<is_tuple<T1> && is_tuple<T2>, cwise_return<Fn, T1, T2>> cwise(Fn&& fn, T1&& t1, T2&& t2, std::index_sequence<Is...>) {
-    return {std::invoke(fn, t1[Is], t2[Is])...};
+    return {tutil::invoke(fn, t1[Is], t2[Is])...};
 }
 
 // tuple, scalar
 template <typename Fn, typename T1, typename S2, std::size_t... Is>
 constexpr eif<is_tuple<T1> && ! is_tuple<S2>, cwise_return<Fn, T1, S2>> cwise(Fn&& fn, T1&& t1, S2&& s2, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, t1[Is], s2)...};
+    return {tutil::invoke(fn, t1[Is], s2)...};
 }
 
 // scalar, tuple
 template <typename Fn, typename S1, typename T2, std::size_t... Is>
 constexpr eif< ! is_tuple<S1> && is_tuple<T2>, cwise_return<Fn, S1, T2>> cwise(Fn&& fn, S1&& s1, T2&& t2, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, s1, t2[Is])...};
+    return {tutil::invoke(fn, s1, t2[Is])...};
 }
 
 /* 3 parameters */
 // tuple, tuple, tuple
 template <typename Fn, typename T1, typename T2, typename T3, std::size_t... Is>
 constexpr eif<is_tuple<T1> && is_tuple<T2> && is_tuple<T3>, cwise_return<Fn, T1, T2, T3>> cwise(Fn&& fn, T1&& t1, T2&& t2, T3&& t3, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, t1[Is], t2[Is], t3[Is])...};
+    return {tutil::invoke(fn, t1[Is], t2[Is], t3[Is])...};
 }
 
 // tuple, tuple, scalar
 template <typename Fn, typename T1, typename T2, typename S3, std::size_t... Is>
 constexpr eif<is_tuple<T1> && is_tuple<T2> && ! is_tuple<S3>, cwise_return<Fn, T1, T2, S3>> cwise(Fn&& fn, T1&& t1, T2&& t2, S3&& s3, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, t1[Is], t2[Is], s3)...};
+    return {tutil::invoke(fn, t1[Is], t2[Is], s3)...};
 }
 
 // tuple, scalar, tuple
 template <typename Fn, typename T1, typename S2, typename T3, std::size_t... Is>
 constexpr eif<is_tuple<T1> && ! is_tuple<S2> && is_tuple<T3>, cwise_return<Fn, T1, S2, T3>> cwise(Fn&& fn, T1&& t1, S2&& s2, T3&& t3, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, t1[Is], s2, t3[Is])...};
+    return {tutil::invoke(fn, t1[Is], s2, t3[Is])...};
 }
 
 // scalar, tuple, tuple
 template <typename Fn, typename S1, typename T2, typename T3, std::size_t... Is>
 constexpr eif< ! is_tuple<S1> && is_tuple<T2> && is_tuple<T3>, cwise_return<Fn, S1, T2, T3>> cwise(Fn&& fn, S1&& s1, T2&& t2, T3&& t3, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, s1, t2[Is], t3[Is])...};
+    return {tutil::invoke(fn, s1, t2[Is], t3[Is])...};
 }
 
 // tuple, scalar, scalar
 template <typename Fn, typename T1, typename S2, typename S3, std::size_t... Is>
 constexpr eif<is_tuple<T1> && ! is_tuple<S2> && ! is_tuple<S3>, cwise_return<Fn, T1, S2, S3>> cwise(Fn&& fn, T1&& t1, S2&& s2, S3&& s3, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, t1[Is], s2, s3)...};
+    return {tutil::invoke(fn, t1[Is], s2, s3)...};
 }
 
 // scalar, tuple, scalar
 template <typename Fn, typename S1, typename T2, typename S3, std::size_t... Is>
 constexpr eif< ! is_tuple<S1> && is_tuple<T2> && ! is_tuple<S3>, cwise_return<Fn, S1, T2, S3>> cwise(Fn&& fn, S1&& s1, T2&& t2, S3&& s3, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, s1, t2[Is], s3)...};
+    return {tutil::invoke(fn, s1, t2[Is], s3)...};
 }
 
 // scalar, scalar, tuple
 template <typename Fn, typename S1, typename S2, typename T3, std::size_t... Is>
 constexpr eif< ! is_tuple<S1> && ! is_tuple<S2> && is_tuple<T3>, cwise_return<Fn, S1, S2, T3>> cwise(Fn&& fn, S1&& s1, S2&& s2, T3&& t3, std::index_sequence<Is...>) {
-    return {std::invoke<Fn>(fn, s1, s2, t3[Is])...};
+    return {tutil::invoke(fn, s1, s2, t3[Is])...};
+}
+
+/**
+ * Vectorized cwise for std::plus, minus, multiplies, divides, the comparisons
+ * and ee::ops on tuples of float or double, scalar arguments being broadcast.
+ * It gives the same results as the scalar path, the one used in constant
+ * expressions, for other callables or value types, or without EE_SIMD.
+ */
+template <template <typename> typename Op, typename Fn, typename V>
+constexpr bool is_op = std::is_same_v<Fn, Op<void>> || std::is_same_v<Fn, Op<V>>;
+
+template <typename Fn, typename V>
+constexpr bool is_simd_compare =
+is_op<std::less, Fn, V> || is_op<std::less_equal, Fn, V> || is_op<std::greater, Fn, V> ||
+is_op<std::greater_equal, Fn, V> || is_op<std::equal_to, Fn, V> || is_op<std::not_equal_to, Fn, V>;
+
+template <typename Fn, typename V, typename P>
+constexpr std::size_t simd_arity() {
+    if constexpr (P::width == 0) {
+        return 0;
+    }
+    else if constexpr (is_op<std::plus, Fn, V> || is_op<std::minus, Fn, V> || is_op<std::multiplies, Fn, V> ||
+                       is_op<std::divides, Fn, V> || std::is_same_v<Fn, ops::min> || std::is_same_v<Fn, ops::max> ||
+                       is_simd_compare<Fn, V>) {
+        return 2;
+    }
+    else if constexpr (std::is_same_v<Fn, ops::fma> && P::has_fma) {
+        return 3;
+    }
+    else {
+        return 0;
+    }
+}
+
+template <std::size_t N, typename T>
+constexpr bool has_size() {
+    if constexpr (is_tuple<T>) {
+        return std::tuple_size_v<std::decay_t<T>> == N;
+    }
+    else {
+        return true;
+    }
+}
+
+template <typename Fn, typename... Ts>
+constexpr bool simd_cwise_enabled() {
+    using tuple = find_first_tuple<Ts...>;
+    using V = find_value_type<tuple>;
+    constexpr std::size_t N = std::tuple_size_v<tuple>;
+    using P = simd::pack_for<V, N>;
+
+    if constexpr (simd_arity<Fn, V, P>() != sizeof...(Ts) ||
+                  ! (std::is_same_v<find_value_type<std::decay_t<Ts>>, V> && ...) ||
+                  ! (has_size<N, Ts>() && ...)) {
+        return false;
+    }
+    else {
+        using R = cwise_return<Fn, Ts...>;
+
+        return is_tuple<R> && std::is_same_v<find_value_type<R>, std::conditional_t<is_simd_compare<Fn, V>, bool, V>>;
+    }
+}
+
+template <typename T>
+constexpr const auto& component(const T& t, std::size_t i) {
+    if constexpr (is_tuple<T>) {
+        return t[i];
+    }
+    else {
+        return t;
+    }
+}
+
+template <typename P, typename T>
+typename P::type simd_load(const T& t, std::size_t i) {
+    if constexpr (is_tuple<T>) {
+        return P::load(&t[i]);
+    }
+    else {
+        return P::set1(t);
+    }
+}
+
+template <typename P, typename Fn, typename V, typename... Vs>
+typename P::type simd_apply(Vs... vs) {
+    if constexpr (is_op<std::plus, Fn, V>) { return P::add(vs...); }
+    else if constexpr (is_op<std::minus, Fn, V>) { return P::sub(vs...); }
+    else if constexpr (is_op<std::multiplies, Fn, V>) { return P::mul(vs...); }
+    else if constexpr (is_op<std::divides, Fn, V>) { return P::div(vs...); }
+    else if constexpr (std::is_same_v<Fn, ops::min>) { return P::min(vs...); }
+    else if constexpr (std::is_same_v<Fn, ops::max>) { return P::max(vs...); }
+    else if constexpr (std::is_same_v<Fn, ops::fma>) { return P::fma(vs...); }
+    else if constexpr (is_op<std::less, Fn, V>) { return P::lt(vs...); }
+    else if constexpr (is_op<std::less_equal, Fn, V>) { return P::le(vs...); }
+    else if constexpr (is_op<std::greater, Fn, V>) { return P::gt(vs...); }
+    else if constexpr (is_op<std::greater_equal, Fn, V>) { return P::ge(vs...); }
+    else if constexpr (is_op<std::equal_to, Fn, V>) { return P::eq(vs...); }
+    else { return P::ne(vs...); }
+}
+
+/**
+ * Fill r from component I on, with the widest pack fitting in what remains,
+ * given by pack_at(P{}, i), the last components one by one when none does,
+ * given by component_at(i).
+ */
+template <std::size_t I, bool Compare, typename V, typename R, typename PackAt, typename ComponentAt>
+void simd_fill_from(R& r, const PackAt& pack_at, const ComponentAt& component_at) {
+    constexpr std::size_t N = std::tuple_size_v<R>;
+    using P = simd::pack_for<V, N - I>;
+
+    if constexpr (I == N) {
+        return;
+    }
+    else if constexpr (P::width == 0) {
+        for (std::size_t i = I; i < N; ++ i) {
+            r[i] = component_at(i);
+        }
+    }
+    else {
+        const auto v = pack_at(P{}, I);
+
+        if constexpr (Compare) {
+            const unsigned bits = P::mask(v);
+
+            for (std::size_t k = 0; k < P::width; ++ k) {
+                r[I + k] = (bits >> k) & 1;
+            }
+        }
+        else {
+            P::store(&r[I], v);
+        }
+
+        simd_fill_from<I + P::width, Compare, V>(r, pack_at, component_at);
+    }
+}
+
+template <typename Fn, typename... Ts>
+cwise_return<Fn, Ts...> cwise_simd(const Ts&... ts) {
+    using F = std::decay_t<Fn>;
+    using V = find_value_type<find_first_tuple<Ts...>>;
+
+    cwise_return<Fn, Ts...> r{};
+
+    simd_fill_from<0, is_simd_compare<F, V>, V>(r, [&](auto pack, std::size_t i) {
+        using P = decltype(pack);
+
+        return simd_apply<P, F, V>(simd_load<P>(ts, i)...);
+    }, [&](std::size_t i) {
+        return tutil::invoke(F{}, component(ts, i)...);
+    });
+
+    return r;
+}
+
+} // namespace detail
+
+namespace detail {
+
+// contiguous range of tuples, as taken by cwise_batch
+template <typename T, typename = void>
+struct is_tuple_range_impl : std::false_type {};
+
+template <typename T>
+struct is_tuple_range_impl<T, std::void_t<decltype(std::declval<T&>().data()), decltype(std::declval<T&>().size())>> :
+std::bool_constant< ! is_tuple<T> && std::is_pointer_v<decltype(std::declval<T&>().data())> &&
+                   is_tuple<std::remove_pointer_t<decltype(std::declval<T&>().data())>>> {};
+
+template <typename T>
+constexpr bool is_tuple_range = is_tuple_range_impl<std::remove_reference_t<T>>::value;
+
+// what cwise_return sees of a range argument: its elements
+template <typename T, typename = void>
+struct element_type {
+    using type = std::decay_t<T>;
+};
+
+template <typename T>
+struct element_type<T, eif<is_tuple_range<T>>> {
+    using type = std::decay_t<decltype(*std::declval<T&>().data())>;
+};
+
+template <typename T>
+using element_t = typename element_type<T>::type;
+
+template <typename T>
+bool size_matches(std::size_t size, const T& t) {
+    if constexpr (is_tuple_range<T>) {
+        return t.size() == size;
+    }
+    else {
+        return true;
+    }
+}
+
+// whether every range argument has size elements
+template <typename... Ts>
+bool sizes_match(std::size_t size, const Ts&... ts) {
+    return (size_matches(size, ts) && ...);
 }
 
 } // namespace detail
@@ -189,9 +428,16 @@ template <typename Fn, typename... Ts>
 constexpr decltype(auto) cwise(Fn&& fn, Ts&&... ts) {
     using tuple = find_first_tuple<Ts...>;
 
-    static_assert( ! std::is_void_v<tuple>, "cwise needs at least one argument to be tuple type");
     static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) < 4, "cwise accepts 1 to 3 data arguments");
 
+    static_assert( ! std::is_void_v<tuple>, "cwise needs at least one argument to be tuple type");
+
+    if constexpr (detail::simd_cwise_enabled<std::decay_t<Fn>, Ts...>()) {
+        if ( ! simd::constant_evaluated()) {
+            return detail::cwise_simd<Fn, Ts...>(ts...);
+        }
+    }
+
     return detail::cwise(std::forward<Fn>(fn), std::forward<Ts>(ts)..., std::make_index_sequence<std::tuple_size_v<tuple>>());
 }
 
@@ -202,7 +448,7 @@ namespace detail {
 
 template <typename Fn, typename T, std::size_t... Is>
 constexpr decltype(auto) split(Fn&& fn, T&& t, std::index_sequence<Is...>) {
-    return std::invoke<Fn>(std::forward<Fn>(fn), t[Is]...);
+    return tutil::invoke(std::forward<Fn>(fn), t[Is]...);
 }
 
 } // namespace detail
@@ -213,4 +459,544 @@ constexpr decltype(auto) split(Fn&& fn, T&& t) {
                          std::make_index_sequence<std::tuple_size_v<std::decay_t<T>>>());
 }
 
+/**
+ * Fold tuple components from left to right, as
+ * fn(... fn(fn(init, t[0]), t[1]) ..., t[N - 1]).
+ */
+namespace detail {
+
+template <typename Fn, typename R, typename T, std::size_t... Is>
+constexpr R cwise_fold(Fn& fn, R acc, const T& t, std::index_sequence<Is...>) {
+    ((acc = tutil::invoke(fn, std::move(acc), t[Is])), ...);
+
+    return acc;
+}
+
+} // namespace detail
+
+template <typename Fn, typename R, typename T, typename = eif<is_tuple<T>>>
+constexpr R cwise_fold(Fn&& fn, R init, const T& t) {
+    return detail::cwise_fold(fn, std::move(init), t, std::make_index_sequence<std::tuple_size_v<T>>());
+}
+
+/**
+ * Combine tuple components with fn, expected to be associative and
+ * commutative, pairing them as a vector unit does: while n components are
+ * left, the first n / 2 are combined with the last n / 2, the middle one
+ * staying as is when n is odd. Sums, products, min and max of float or double
+ * tuples of a power of two size are vectorized, with that same order.
+ */
+namespace detail {
+
+template <std::size_t N, typename Fn, typename A, std::size_t... Is>
+constexpr void reduce_halves(Fn& fn, A& x, std::index_sequence<Is...>) {
+    ((x[Is] = tutil::invoke(fn, x[Is], x[Is + N - sizeof...(Is)])), ...);
+}
+
+template <std::size_t N, typename Fn, typename A>
+constexpr void reduce_tree(Fn& fn, A& x) {
+    if constexpr (N > 1) {
+        reduce_halves<N>(fn, x, std::make_index_sequence<N / 2>());
+        reduce_tree<N - N / 2>(fn, x);
+    }
+}
+
+template <typename Fn, typename T, std::size_t... Is>
+constexpr find_value_type<T> cwise_reduce(Fn& fn, const T& t, std::index_sequence<Is...>) {
+    std::array<find_value_type<T>, sizeof...(Is)> x{t[Is]...};
+
+    reduce_tree<sizeof...(Is)>(fn, x);
+
+    return x[0];
+}
+
+template <typename Fn, typename T>
+constexpr bool simd_reduce_enabled() {
+    using V = find_value_type<T>;
+    constexpr std::size_t N = std::tuple_size_v<T>;
+
+    if constexpr (simd::pack_for<V, N>::width == 0 || (N & (N - 1)) != 0) {
+        return false;
+    }
+    else {
+        return is_op<std::plus, Fn, V> || is_op<std::multiplies, Fn, V> ||
+               std::is_same_v<Fn, ops::min> || std::is_same_v<Fn, ops::max>;
+    }
+}
+
+template <typename P, typename Fn, typename V, std::size_t K>
+V simd_reduce_pack(typename P::type v) {
+    if constexpr (K == 0) {
+        return P::first(v);
+    }
+    else {
+        return simd_reduce_pack<P, Fn, V, K / 2>(simd_apply<P, Fn, V>(v, P::template down<K>(v)));
+    }
+}
+
+template <typename Fn, typename T>
+find_value_type<T> cwise_reduce_simd(const T& t) {
+    using V = find_value_type<T>;
+    constexpr std::size_t N = std::tuple_size_v<T>;
+    using P = simd::pack_for<V, N>;
+    constexpr std::size_t M = N / P::width;
+
+    typename P::type packs[M];
+
+    for (std::size_t j = 0; j < M; ++ j) {
+        packs[j] = P::load(&t[j * P::width]);
+    }
+
+    for (std::size_t m = M; m > 1; m /= 2) {
+        for (std::size_t j = 0; j < m / 2; ++ j) {
+            packs[j] = simd_apply<P, Fn, V>(packs[j], packs[j + m / 2]);
+        }
+    }
+
+    return simd_reduce_pack<P, Fn, V, P::width / 2>(packs[0]);
+}
+
+} // namespace detail
+
+template <typename Fn, typename T, typename = eif<is_tuple<T>>>
+constexpr find_value_type<T> cwise_reduce(Fn&& fn, const T& t) {
+    static_assert(std::tuple_size_v<T> > 0, "cwise_reduce needs at least one component");
+
+    if constexpr (detail::simd_reduce_enabled<std::decay_t<Fn>, T>()) {
+        if ( ! simd::constant_evaluated()) {
+            return detail::cwise_reduce_simd<std::decay_t<Fn>>(t);
+        }
+    }
+
+    return detail::cwise_reduce(fn, t, std::make_index_sequence<std::tuple_size_v<T>>());
+}
+
+template <typename T, typename = eif<is_tuple<T>>>
+constexpr find_value_type<T> hsum(const T& t) {
+    return cwise_reduce(std::plus<>{}, t);
+}
+
+template <typename T, typename = eif<is_tuple<T>>>
+constexpr find_value_type<T> hmin(const T& t) {
+    return cwise_reduce(ops::min{}, t);
+}
+
+template <typename T, typename = eif<is_tuple<T>>>
+constexpr find_value_type<T> hmax(const T& t) {
+    return cwise_reduce(ops::max{}, t);
+}
+
+/**
+ * Sum of componentwise products, in cwise_reduce order.
+ */
+template <typename T1, typename T2, typename = eif<is_tuple<T1> && is_tuple<T2>>>
+constexpr auto dot(const T1& t1, const T2& t2) {
+    return hsum(cwise(std::multiplies<>{}, t1, t2));
+}
+
+/**
+ * Whether all or any components convert to true, or all or any results of fn
+ * called componentwise do, as with cwise. Comparisons of float or double
+ * tuples are tested on vector masks, stopping at the first deciding pack.
+ */
+namespace detail {
+
+template <typename T, std::size_t... Is>
+constexpr bool all_of(const T& t, std::index_sequence<Is...>) {
+    return (static_cast<bool>(t[Is]) && ...);
+}
+
+template <typename T, std::size_t... Is>
+constexpr bool any_of(const T& t, std::index_sequence<Is...>) {
+    return (static_cast<bool>(t[Is]) || ...);
+}
+
+template <std::size_t I, bool All, typename Fn, typename V, std::size_t N, typename... Ts>
+bool simd_test_from(const Ts&... ts) {
+    using P = simd::pack_for<V, N - I>;
+
+    if constexpr (I == N) {
+        return All;
+    }
+    else if constexpr (P::width == 0) {
+        for (std::size_t i = I; i < N; ++ i) {
+            if (static_cast<bool>(tutil::invoke(Fn{}, component(ts, i)...)) != All) {
+                return ! All;
+            }
+        }
+
+        return All;
+    }
+    else {
+        const unsigned bits = P::mask(simd_apply<P, Fn, V>(simd_load<P>(ts, I)...));
+
+        if (All ? bits != (1u << P::width) - 1 : bits != 0) {
+            return ! All;
+        }
+
+        return simd_test_from<I + P::width, All, Fn, V, N>(ts...);
+    }
+}
+
+template <typename Fn, typename... Ts>
+constexpr bool simd_test_enabled() {
+    if constexpr ( ! simd_cwise_enabled<Fn, Ts...>()) {
+        return false;
+    }
+    else {
+        return is_simd_compare<Fn, find_value_type<find_first_tuple<Ts...>>>;
+    }
+}
+
+template <bool All, typename Fn, typename... Ts>
+bool simd_test(const Ts&... ts) {
+    using tuple = find_first_tuple<Ts...>;
+
+    return simd_test_from<0, All, Fn, find_value_type<tuple>, std::tuple_size_v<tuple>>(ts...);
+}
+
+} // namespace detail
+
+template <typename T, typename = eif<is_tuple<T>>>
+constexpr bool all_of(const T& t) {
+    return detail::all_of(t, std::make_index_sequence<std::tuple_size_v<T>>());
+}
+
+template <typename T, typename = eif<is_tuple<T>>>
+constexpr bool any_of(const T& t) {
+    return detail::any_of(t, std::make_index_sequence<std::tuple_size_v<T>>());
+}
+
+template <typename Fn, typename T1, typename... Ts>
+constexpr bool all_of(Fn&& fn, T1&& t1, Ts&&... ts) {
+    if constexpr (detail::simd_test_enabled<std::decay_t<Fn>, T1, Ts...>()) {
+        if ( ! simd::constant_evaluated()) {
+            return detail::simd_test<true, std::decay_t<Fn>>(t1, ts...);
+        }
+    }
+
+    return all_of(cwise(std::forward<Fn>(fn), std::forward<T1>(t1), std::forward<Ts>(ts)...));
+}
+
+template <typename Fn, typename T1, typename... Ts>
+constexpr bool any_of(Fn&& fn, T1&& t1, Ts&&... ts) {
+    if constexpr (detail::simd_test_enabled<std::decay_t<Fn>, T1, Ts...>()) {
+        if ( ! simd::constant_evaluated()) {
+            return detail::simd_test<false, std::decay_t<Fn>>(t1, ts...);
+        }
+    }
+
+    return any_of(cwise(std::forward<Fn>(fn), std::forward<T1>(t1), std::forward<Ts>(ts)...));
+}
+
+/**
+ * Opt-in lazy cwise. cwise_lazy returns an expression node rather than a
+ * tuple, nodes being usable as arguments of other cwise_lazy calls. A tree of
+ * nodes is evaluated in one pass when converted to its result type, the
+ * cwise_return of its callable and operands as for cwise, without building
+ * any intermediate tuple. Trees of the operations cwise vectorizes are
+ * evaluated pack by pack.
+ * Nodes refer to lvalue arguments and hold rvalue ones, a node kept in a
+ * variable must not outlive the lvalues it refers to.
+ */
+template <typename Fn, typename... Ts>
+class CwiseExpr;
+
+namespace detail {
+
+template <typename T>
+struct is_cwise_expr_impl : std::false_type {};
+
+template <typename Fn, typename... Ts>
+struct is_cwise_expr_impl<CwiseExpr<Fn, Ts...>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_cwise_expr = is_cwise_expr_impl<std::decay_t<T>>::value;
+
+// what cwise_return sees of an operand
+template <typename T, typename = void>
+struct operand_type {
+    using type = std::decay_t<T>;
+};
+
+template <typename T>
+struct operand_type<T, eif<is_cwise_expr<T>>> {
+    using type = typename std::decay_t<T>::result_type;
+};
+
+template <typename T>
+using operand_t = typename operand_type<T>::type;
+
+template <typename T>
+constexpr decltype(auto) lazy_component(const T& t, std::size_t i) {
+    if constexpr (is_cwise_expr<T> || is_tuple<T>) {
+        return t[i];
+    }
+    else {
+        return (t);
+    }
+}
+
+template <typename P, typename T>
+typename P::type lazy_pack(const T& t, std::size_t i) {
+    if constexpr (is_cwise_expr<T>) {
+        return t.template pack<P>(i);
+    }
+    else {
+        return simd_load<P>(t, i);
+    }
+}
+
+template <typename T>
+constexpr bool lazy_simd_operand() {
+    if constexpr (is_cwise_expr<T>) {
+        return std::decay_t<T>::simd_enabled;
+    }
+    else {
+        return true;
+    }
+}
+
+} // namespace detail
+
+template <typename Fn, typename... Ts>
+class CwiseExpr {
+    public:
+        using result_type = detail::cwise_return<Fn, detail::operand_t<Ts>...>;
+        using value_type = find_value_type<result_type>;
+
+        template <typename F, typename... Us>
+        constexpr explicit CwiseExpr(F&& fn, Us&&... ts) :
+            fn_(std::forward<F>(fn)),
+            ts_(std::forward<Us>(ts)...) {}
+
+        /**
+         * Component i of the result, computed through the whole tree.
+         */
+        constexpr value_type operator[](std::size_t i) const {
+            return component(i, std::index_sequence_for<Ts...>());
+        }
+
+        constexpr result_type eval() const {
+            if constexpr (simd_enabled) {
+                if ( ! simd::constant_evaluated()) {
+                    result_type r{};
+
+                    detail::simd_fill_from<0, detail::is_simd_compare<Fn, operand_value>, operand_value>(r,
+                    [this](auto pack, std::size_t i) {
+                        return this->pack<decltype(pack)>(i);
+                    }, [this](std::size_t i) {
+                        return (*this)[i];
+                    });
+
+                    return r;
+                }
+            }
+
+            return eval(std::make_index_sequence<std::tuple_size_v<result_type>>());
+        }
+
+        constexpr operator result_type() const {
+            return eval();
+        }
+
+        /**
+         * Whether the tree is evaluated pack by pack, and a pack of the
+         * result from component i on, for enclosing nodes.
+         */
+        static constexpr bool simd_enabled =
+            detail::simd_cwise_enabled<Fn, detail::operand_t<Ts>...>() && (detail::lazy_simd_operand<Ts>() && ...);
+
+        template <typename P>
+        typename P::type pack(std::size_t i) const {
+            return pack<P>(i, std::index_sequence_for<Ts...>());
+        }
+
+    private:
+        using operand_value = find_value_type<find_first_tuple<detail::operand_t<Ts>...>>;
+
+        template <std::size_t... Js>
+        constexpr value_type component(std::size_t i, std::index_sequence<Js...>) const {
+            return tutil::invoke(fn_, detail::lazy_component(std::get<Js>(ts_), i)...);
+        }
+
+        template <std::size_t... Is>
+        constexpr result_type eval(std::index_sequence<Is...>) const {
+            return {(*this)[Is]...};
+        }
+
+        template <typename P, std::size_t... Js>
+        typename P::type pack(std::size_t i, std::index_sequence<Js...>) const {
+            return detail::simd_apply<P, Fn, operand_value>(detail::lazy_pack<P>(std::get<Js>(ts_), i)...);
+        }
+
+        Fn fn_;
+        std::tuple<Ts...> ts_;
+};
+
+template <typename Fn, typename... Ts>
+constexpr CwiseExpr<std::decay_t<Fn>, Ts...> cwise_lazy(Fn&& fn, Ts&&... ts) {
+    using tuple = find_first_tuple<detail::operand_t<Ts>...>;
+
+    static_assert( ! std::is_void_v<tuple>, "cwise_lazy needs at least one argument to be tuple type or expression");
+    static_assert((detail::has_size<std::tuple_size_v<tuple>, detail::operand_t<Ts>>() && ...),
+                  "cwise_lazy arguments must have the same size");
+
+    return CwiseExpr<std::decay_t<Fn>, Ts...>(std::forward<Fn>(fn), std::forward<Ts>(ts)...);
+}
+
+/**
+ * In place cwise: cwise_assign(fn, dst, args...) sets each dst[i] to fn called
+ * on the components i of args, tuples, scalars or cwise_lazy expressions,
+ * without building a result tuple. cwise_compound(fn, dst, args...) passes
+ * dst[i] first, add_assign and the like being its shorthands. Components
+ * only depend on the same index of the arguments, dst may be one of them.
+ * Vectorized as cwise is.
+ */
+namespace detail {
+
+template <typename Fn, typename... Ts>
+constexpr bool nothrow_cwise = std::is_nothrow_invocable_v<Fn&, decltype(lazy_component(std::declval<const Ts&>(), 0))...>;
+
+template <typename Fn, typename T, typename... Ts>
+constexpr bool simd_assign_enabled() {
+    if constexpr ( ! simd_cwise_enabled<Fn, operand_t<Ts>...>() || ! (lazy_simd_operand<Ts>() && ...)) {
+        return false;
+    }
+    else {
+        using V = find_value_type<find_first_tuple<operand_t<Ts>...>>;
+
+        return ! is_simd_compare<Fn, V> && std::is_same_v<find_value_type<T>, V>;
+    }
+}
+
+template <std::size_t I, typename Fn, typename T, typename... Ts>
+constexpr void assign_component(Fn& fn, T& dst, const Ts&... ts) noexcept(nothrow_cwise<Fn, Ts...>) {
+    dst[I] = tutil::invoke(fn, lazy_component(ts, I)...);
+}
+
+template <typename Fn, typename T, typename... Ts, std::size_t... Is>
+constexpr void cwise_assign(Fn& fn, T& dst, std::index_sequence<Is...>, const Ts&... ts)
+noexcept(nothrow_cwise<Fn, Ts...>) {
+    (assign_component<Is>(fn, dst, ts...), ...);
+}
+
+} // namespace detail
+
+template <typename Fn, typename T, typename... Ts, typename = eif<is_tuple<T>>>
+constexpr T& cwise_assign(Fn&& fn, T& dst, const Ts&... ts) noexcept(detail::nothrow_cwise<std::decay_t<Fn>, Ts...>) {
+    constexpr std::size_t N = std::tuple_size_v<T>;
+
+    static_assert(sizeof...(Ts) > 0, "cwise_assign needs at least one argument");
+    static_assert((detail::has_size<N, detail::operand_t<Ts>>() && ...), "cwise_assign arguments must have the size of dst");
+
+    using F = std::decay_t<Fn>;
+
+    if constexpr (detail::simd_assign_enabled<F, T, Ts...>()) {
+        if ( ! simd::constant_evaluated()) {
+            using V = find_value_type<T>;
+
+            detail::simd_fill_from<0, false, V>(dst, [&](auto pack, std::size_t i) {
+                using P = decltype(pack);
+
+                return detail::simd_apply<P, F, V>(detail::lazy_pack<P>(ts, i)...);
+            }, [&](std::size_t i) {
+                return tutil::invoke(fn, detail::lazy_component(ts, i)...);
+            });
+
+            return dst;
+        }
+    }
+
+    detail::cwise_assign(fn, dst, std::make_index_sequence<N>(), ts...);
+
+    return dst;
+}
+
+template <typename Fn, typename T, typename... Ts, typename = eif<is_tuple<T>>>
+constexpr T& cwise_compound(Fn&& fn, T& dst, const Ts&... ts) noexcept(detail::nothrow_cwise<std::decay_t<Fn>, T, Ts...>) {
+    return cwise_assign(std::forward<Fn>(fn), dst, dst, ts...);
+}
+
+template <typename T, typename U, typename = eif<is_tuple<T>>>
+constexpr T& add_assign(T& dst, const U& u) noexcept(noexcept(cwise_compound(std::plus<>{}, dst, u))) {
+    return cwise_compound(std::plus<>{}, dst, u);
+}
+
+template <typename T, typename U, typename = eif<is_tuple<T>>>
+constexpr T& sub_assign(T& dst, const U& u) noexcept(noexcept(cwise_compound(std::minus<>{}, dst, u))) {
+    return cwise_compound(std::minus<>{}, dst, u);
+}
+
+template <typename T, typename U, typename = eif<is_tuple<T>>>
+constexpr T& mul_assign(T& dst, const U& u) noexcept(noexcept(cwise_compound(std::multiplies<>{}, dst, u))) {
+    return cwise_compound(std::multiplies<>{}, dst, u);
+}
+
+template <typename T, typename U, typename = eif<is_tuple<T>>>
+constexpr T& div_assign(T& dst, const U& u) noexcept(noexcept(cwise_compound(std::divides<>{}, dst, u))) {
+    return cwise_compound(std::divides<>{}, dst, u);
+}
+
+template <typename T, typename U, typename = eif<is_tuple<T>>>
+constexpr T& min_assign(T& dst, const U& u) noexcept(noexcept(cwise_compound(ops::min{}, dst, u))) {
+    return cwise_compound(ops::min{}, dst, u);
+}
+
+template <typename T, typename U, typename = eif<is_tuple<T>>>
+constexpr T& max_assign(T& dst, const U& u) noexcept(noexcept(cwise_compound(ops::max{}, dst, u))) {
+    return cwise_compound(ops::max{}, dst, u);
+}
+
+/**
+ * Batch cwise over contiguous ranges of tuples, containers or Spans:
+ * cwise_batch(fn, out, args...) sets each out[i] to cwise(fn, args[i]...),
+ * args being ranges of out's size, or tuples and scalars broadcast to every
+ * element. It is a convenience loop, as fast as calling cwise on each
+ * element, out may be one of args.
+ */
+namespace detail {
+
+// element i of a range, tuples and scalars as they are
+template <typename T>
+const auto& batch_element(const T& t, std::size_t i) {
+    if constexpr (is_tuple_range<T>) {
+        return t.data()[i];
+    }
+    else {
+        return t;
+    }
+}
+
+// elements [begin, end) of a range, tuples and scalars as they are
+template <typename T>
+decltype(auto) batch_slice(const T& t, std::size_t begin, std::size_t end) {
+    if constexpr (is_tuple_range<T>) {
+        return Span<const element_t<T>>(t.data() + begin, end - begin);
+    }
+    else {
+        return (t);
+    }
+}
+
+} // namespace detail
+
+template <typename Fn, typename Out, typename... Ts, typename = eif<detail::is_tuple_range<Out>>>
+void cwise_batch(Fn&& fn, Out&& out, const Ts&... ts) {
+    static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) < 4, "cwise_batch accepts 1 to 3 data arguments");
+    static_assert((detail::is_tuple_range<Ts> || ...), "cwise_batch needs at least one argument to be a range of tuples");
+    static_assert(std::is_same_v<detail::cwise_return<std::decay_t<Fn>, detail::element_t<Ts>...>, detail::element_t<Out>>,
+                  "cwise_batch out elements must be of the cwise result type");
+    static_assert((detail::has_size<std::tuple_size_v<detail::element_t<Out>>, detail::element_t<Ts>>() && ...),
+                  "cwise_batch arguments must have elements of the size of out ones");
+
+    assert(detail::sizes_match(out.size(), ts...) && "cwise_batch range arguments must have the size of out");
+
+    auto* elements = out.data();
+
+    for (std::size_t i = 0; i < out.size(); ++ i) {
+        elements[i] = cwise(fn, detail::batch_element(ts, i)...);
+    }
+}
+
 } // namespace ee
@@ -0,0 +1,349 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Span.hpp"
+#include "ThreadPool.hpp"
+#include "componentwise.hpp"
+
+namespace ee {
+
+/**
+ * Parallel counterparts of some standard algorithms, running on a ThreadPool
+ * through split_for with the calling thread helping. Ranges are random
+ * access, ranges are cut in contiguous blocks of at least grain elements and
+ * operations passed to reduce and scans are expected to be associative.
+ */
+namespace par {
+namespace detail {
+
+constexpr std::size_t grain = 2048;
+
+/**
+ * Number of blocks to cut count elements in, a few per thread for balance.
+ */
+inline std::size_t block_count(const ThreadPool& pool, std::size_t count) {
+    const std::size_t most = 4 * (pool.worker_count() + 1);
+
+    return std::max<std::size_t>(std::min((count + grain - 1) / grain, most), 1);
+}
+
+inline std::size_t block_begin(std::size_t block, std::size_t blocks, std::size_t count) {
+    return block * count / blocks;
+}
+
+/**
+ * Call fn(block, begin, end) for each of blocks blocks of [0, count).
+ */
+template <typename Fn>
+void for_blocks(ThreadPool& pool, std::size_t count, std::size_t blocks, Fn&& fn) {
+    split_for(pool, blocks, 1, blocks, 1, [&](std::size_t, std::size_t block) {
+        fn(block, block_begin(block, blocks, count), block_begin(block + 1, blocks, count));
+    });
+}
+
+/**
+ * Number of elements of a taken among the first k of the stable merge of a
+ * and b.
+ */
+template <typename It, typename Compare>
+std::size_t co_rank(std::size_t k, It a, std::size_t na, It b, std::size_t nb, Compare& comp) {
+    std::size_t lo = k > nb ? k - nb : 0;
+    std::size_t hi = std::min(k, na);
+
+    while (lo < hi) {
+        const std::size_t i = lo + (hi - lo) / 2;
+        const std::size_t j = k - i;
+
+        // too few taken from a while a[i] is not after b[j - 1]
+        if (j > 0 && i < na && ! comp(b[j - 1], a[i])) {
+            lo = i + 1;
+        }
+        else {
+            hi = i;
+        }
+    }
+
+    return lo;
+}
+
+} // namespace detail
+
+template <typename It, typename Fn>
+void for_each(ThreadPool& pool, It first, It last, Fn fn) {
+    const std::size_t count = last - first;
+
+    detail::for_blocks(pool, count, detail::block_count(pool, count),
+                       [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::for_each(first + begin, first + end, fn);
+    });
+}
+
+template <typename It, typename T, typename Reduce, typename Transform>
+T transform_reduce(ThreadPool& pool, It first, It last, T init, Reduce reduce, Transform transform) {
+    const std::size_t count = last - first;
+    const std::size_t blocks = detail::block_count(pool, count);
+
+    std::vector<std::optional<T>> partials(blocks);
+
+    detail::for_blocks(pool, count, blocks, [&](std::size_t block, std::size_t begin, std::size_t end) {
+        if (begin == end) {
+            return;
+        }
+
+        T partial = transform(first[begin]);
+
+        for (std::size_t i = begin + 1; i < end; ++ i) {
+            partial = reduce(std::move(partial), transform(first[i]));
+        }
+
+        partials[block] = std::move(partial);
+    });
+
+    for (auto& partial : partials) {
+        if (partial) {
+            init = reduce(std::move(init), std::move(*partial));
+        }
+    }
+
+    return init;
+}
+
+template <typename It, typename T, typename Reduce = std::plus<>>
+T reduce(ThreadPool& pool, It first, It last, T init, Reduce reduce = {}) {
+    return transform_reduce(pool, first, last, std::move(init), reduce,
+                            [](const auto& value) -> const auto& { return value; });
+}
+
+namespace detail {
+
+/**
+ * Three passes scan: block totals, serial scan of the totals, then each block
+ * scans again from its offset. Output may alias input.
+ */
+template <bool Inclusive, typename In, typename Out, typename T, typename Op>
+Out scan(ThreadPool& pool, In first, In last, Out d_first, std::optional<T> init, Op op) {
+    const std::size_t count = last - first;
+    const std::size_t blocks = block_count(pool, count);
+
+    std::vector<std::optional<T>> totals(blocks);
+
+    for_blocks(pool, count, blocks, [&](std::size_t block, std::size_t begin, std::size_t end) {
+        if (begin == end) {
+            return;
+        }
+
+        T total = first[begin];
+
+        for (std::size_t i = begin + 1; i < end; ++ i) {
+            total = op(std::move(total), first[i]);
+        }
+
+        totals[block] = std::move(total);
+    });
+
+    // offsets[b] is what precedes block b
+    std::vector<std::optional<T>> offsets(blocks);
+    std::optional<T> running = init;
+
+    for (std::size_t block = 0; block < blocks; ++ block) {
+        offsets[block] = running;
+
+        if (totals[block]) {
+            running = running ? op(std::move(*running), std::move(*totals[block])) : std::move(*totals[block]);
+        }
+    }
+
+    for_blocks(pool, count, blocks, [&](std::size_t block, std::size_t begin, std::size_t end) {
+        std::optional<T> acc = offsets[block];
+
+        for (std::size_t i = begin; i < end; ++ i) {
+            T value = first[i];
+
+            if (Inclusive) {
+                acc = acc ? op(std::move(*acc), std::move(value)) : std::move(value);
+                d_first[i] = *acc;
+            }
+            else {
+                d_first[i] = *acc;
+                acc = op(std::move(*acc), std::move(value));
+            }
+        }
+    });
+
+    return d_first + count;
+}
+
+} // namespace detail
+
+template <typename In, typename Out, typename Op = std::plus<>>
+Out inclusive_scan(ThreadPool& pool, In first, In last, Out d_first, Op op = {}) {
+    using T = typename std::iterator_traits<In>::value_type;
+
+    return detail::scan<true>(pool, first, last, d_first, std::optional<T>{}, op);
+}
+
+template <typename In, typename Out, typename T, typename Op = std::plus<>>
+Out exclusive_scan(ThreadPool& pool, In first, In last, Out d_first, T init, Op op = {}) {
+    return detail::scan<false>(pool, first, last, d_first, std::optional<T>{std::move(init)}, op);
+}
+
+/**
+ * Parallel merge sort: blocks are sorted, then merged pairwise in rounds,
+ * each merge being cut in independent pieces so that all threads take part in
+ * every round. Needs a buffer of last - first default constructed values.
+ * Like std::sort it is not stable, blocks being sorted with it.
+ */
+template <typename It, typename Compare = std::less<>>
+void sort(ThreadPool& pool, It first, It last, Compare comp = {}) {
+    using T = typename std::iterator_traits<It>::value_type;
+
+    const std::size_t count = last - first;
+    const std::size_t blocks = detail::block_count(pool, count);
+
+    if (blocks == 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    detail::for_blocks(pool, count, blocks, [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::sort(first + begin, first + end, comp);
+    });
+
+    std::vector<T> buffer(count);
+    bool in_buffer = false;
+
+    for (std::size_t width = 1; width < blocks; width *= 2) {
+        const std::size_t pairs = (blocks + 2 * width - 1) / (2 * width);
+        const std::size_t pieces = std::max<std::size_t>(blocks / pairs, 1);
+
+        // pieces read around their bounds, so bounds are all found before
+        // any element is moved
+        std::vector<std::size_t> ranks(pairs * (pieces + 1));
+
+        auto bounds = [&](std::size_t pair) {
+            return std::array<std::size_t, 3>{
+                detail::block_begin(std::min(2 * pair * width, blocks), blocks, count),
+                detail::block_begin(std::min((2 * pair + 1) * width, blocks), blocks, count),
+                detail::block_begin(std::min((2 * pair + 2) * width, blocks), blocks, count)};
+        };
+
+        auto merge_rounds = [&](auto src, auto dst) {
+            split_for(pool, ranks.size(), 1, ranks.size(), 1, [&](std::size_t, std::size_t rank) {
+                const std::size_t pair = rank / (pieces + 1);
+                const std::size_t piece = rank % (pieces + 1);
+                const auto [a, b, e] = bounds(pair);
+                const std::size_t k = piece * (e - a) / pieces;
+
+                ranks[rank] = detail::co_rank(k, src + a, b - a, src + b, e - b, comp);
+            });
+
+            split_for(pool, pairs * pieces, 1, pairs * pieces, 1, [&](std::size_t, std::size_t task) {
+                const std::size_t pair = task / pieces;
+                const std::size_t piece = task % pieces;
+                const auto [a, b, e] = bounds(pair);
+                const std::size_t k0 = piece * (e - a) / pieces;
+                const std::size_t k1 = (piece + 1) * (e - a) / pieces;
+                const std::size_t i0 = ranks[pair * (pieces + 1) + piece];
+                const std::size_t i1 = ranks[pair * (pieces + 1) + piece + 1];
+
+                std::merge(std::make_move_iterator(src + a + i0), std::make_move_iterator(src + a + i1),
+                           std::make_move_iterator(src + b + (k0 - i0)), std::make_move_iterator(src + b + (k1 - i1)),
+                           dst + a + k0, comp);
+            });
+        };
+
+        if (in_buffer) {
+            merge_rounds(buffer.begin(), first);
+        }
+        else {
+            merge_rounds(first, buffer.begin());
+        }
+
+        in_buffer = ! in_buffer;
+    }
+
+    if (in_buffer) {
+        detail::for_blocks(pool, count, blocks, [&](std::size_t, std::size_t begin, std::size_t end) {
+            std::move(buffer.begin() + begin, buffer.begin() + end, first + begin);
+        });
+    }
+}
+
+/**
+ * Stable partition through a buffer: blocks count their matching elements,
+ * then move them at their final place. Returns the first element for which
+ * pred is false, like std::partition. pred is called twice per element and
+ * the buffer of last - first values requires T to be default constructible.
+ */
+template <typename It, typename Pred>
+It partition(ThreadPool& pool, It first, It last, Pred pred) {
+    using T = typename std::iterator_traits<It>::value_type;
+
+    const std::size_t count = last - first;
+    const std::size_t blocks = detail::block_count(pool, count);
+
+    std::vector<std::size_t> matching(blocks + 1, 0);
+
+    detail::for_blocks(pool, count, blocks, [&](std::size_t block, std::size_t begin, std::size_t end) {
+        matching[block + 1] = std::count_if(first + begin, first + end, pred);
+    });
+
+    for (std::size_t block = 0; block < blocks; ++ block) {
+        matching[block + 1] += matching[block];
+    }
+
+    const std::size_t total = matching[blocks];
+    std::vector<T> buffer(count);
+
+    detail::for_blocks(pool, count, blocks, [&](std::size_t block, std::size_t begin, std::size_t end) {
+        std::size_t yes = matching[block];
+        std::size_t no = total + begin - matching[block];
+
+        for (std::size_t i = begin; i < end; ++ i) {
+            buffer[pred(first[i]) ? yes ++ : no ++] = std::move(first[i]);
+        }
+    });
+
+    detail::for_blocks(pool, count, blocks, [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::move(buffer.begin() + begin, buffer.begin() + end, first + begin);
+    });
+
+    return first + total;
+}
+
+/**
+ * cwise_batch with blocks of elements computed on the pool.
+ */
+template <typename Fn, typename Out, typename... Ts, typename = eif<ee::detail::is_tuple_range<Out>>>
+void cwise_batch(ThreadPool& pool, Fn fn, Out&& out, const Ts&... ts) {
+    const std::size_t count = out.size();
+    auto* elements = out.data();
+
+    assert(ee::detail::sizes_match(count, ts...) && "cwise_batch range arguments must have the size of out");
+
+    detail::for_blocks(pool, count, detail::block_count(pool, count),
+                       [&](std::size_t, std::size_t begin, std::size_t end) {
+        ee::cwise_batch(fn, Span<std::remove_pointer_t<decltype(elements)>>(elements + begin, end - begin),
+                        ee::detail::batch_slice(ts, begin, end)...);
+    });
+}
+
+} // namespace par
+} // namespace ee
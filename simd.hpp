@@ -0,0 +1,254 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * Instruction set used by the vectorized code paths, chosen at compile time.
+ * Defaults to the best one the target enables (-msse2, -mavx...), define
+ * EE_SIMD to one of the values below to force another, EE_SIMD_SCALAR
+ * turning vectorization off. FMA instructions are used where the target
+ * enables them (-mfma).
+ */
+#define EE_SIMD_SCALAR 0
+#define EE_SIMD_SSE 1
+#define EE_SIMD_AVX 2
+
+#if ! defined(EE_SIMD)
+#if defined(__AVX__)
+#define EE_SIMD EE_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EE_SIMD EE_SIMD_SSE
+#else
+#define EE_SIMD EE_SIMD_SCALAR
+#endif
+#endif
+
+#if EE_SIMD >= EE_SIMD_AVX
+#include <immintrin.h>
+#elif EE_SIMD >= EE_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+#if EE_SIMD >= EE_SIMD_AVX && defined(__FMA__)
+#define EE_SIMD_FMA 1
+#else
+#define EE_SIMD_FMA 0
+#endif
+
+namespace ee {
+namespace simd {
+
+/**
+ * Whether code is being evaluated as a constant expression, where intrinsics
+ * may not be used.
+ */
+constexpr bool constant_evaluated() {
+#if defined(__GNUC__) || defined(_MSC_VER)
+    return __builtin_is_constant_evaluated();
+#else
+    return true;
+#endif
+}
+
+/**
+ * W values of type T in one register. Only the specializations below exist,
+ * Pack<T, W>::width being 0 for any other pair.
+ *  - load / store: unaligned, as fast as aligned ones on aligned data.
+ *  - min(a, b): b < a ? b : a, as std::min.
+ *  - fma(a, b, c): a * b + c rounded once, only when has_fma.
+ *  - comparisons return a lane mask, read as bits by mask().
+ *  - down<K>(v): lane i + K moved to lane i for i < K, K a power of two
+ *    below W, the other lanes being unspecified.
+ *  - first(v): lane 0.
+ */
+template <typename T, std::size_t W>
+struct Pack {
+    static constexpr std::size_t width = 0;
+};
+
+#if EE_SIMD >= EE_SIMD_SSE
+
+template <>
+struct Pack<float, 4> {
+    using type = __m128;
+    static constexpr std::size_t width = 4;
+    static constexpr bool has_fma = EE_SIMD_FMA;
+
+    static type load(const float* values) { return _mm_loadu_ps(values); }
+    static void store(float* values, type v) { _mm_storeu_ps(values, v); }
+    static type set1(float value) { return _mm_set1_ps(value); }
+
+    static type add(type a, type b) { return _mm_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+    static type div(type a, type b) { return _mm_div_ps(a, b); }
+    static type min(type a, type b) { return _mm_min_ps(b, a); }
+    static type max(type a, type b) { return _mm_max_ps(b, a); }
+#if EE_SIMD_FMA
+    static type fma(type a, type b, type c) { return _mm_fmadd_ps(a, b, c); }
+#endif
+
+    static type lt(type a, type b) { return _mm_cmplt_ps(a, b); }
+    static type le(type a, type b) { return _mm_cmple_ps(a, b); }
+    static type gt(type a, type b) { return _mm_cmpgt_ps(a, b); }
+    static type ge(type a, type b) { return _mm_cmpge_ps(a, b); }
+    static type eq(type a, type b) { return _mm_cmpeq_ps(a, b); }
+    static type ne(type a, type b) { return _mm_cmpneq_ps(a, b); }
+    static unsigned mask(type v) { return static_cast<unsigned>(_mm_movemask_ps(v)); }
+
+    template <std::size_t K>
+    static type down(type v) {
+        if constexpr (K == 2) { return _mm_movehl_ps(v, v); }
+        else { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 2, 1)); }
+    }
+
+    static float first(type v) { return _mm_cvtss_f32(v); }
+};
+
+template <>
+struct Pack<double, 2> {
+    using type = __m128d;
+    static constexpr std::size_t width = 2;
+    static constexpr bool has_fma = EE_SIMD_FMA;
+
+    static type load(const double* values) { return _mm_loadu_pd(values); }
+    static void store(double* values, type v) { _mm_storeu_pd(values, v); }
+    static type set1(double value) { return _mm_set1_pd(value); }
+
+    static type add(type a, type b) { return _mm_add_pd(a, b); }
+    static type sub(type a, type b) { return _mm_sub_pd(a, b); }
+    static type mul(type a, type b) { return _mm_mul_pd(a, b); }
+    static type div(type a, type b) { return _mm_div_pd(a, b); }
+    static type min(type a, type b) { return _mm_min_pd(b, a); }
+    static type max(type a, type b) { return _mm_max_pd(b, a); }
+#if EE_SIMD_FMA
+    static type fma(type a, type b, type c) { return _mm_fmadd_pd(a, b, c); }
+#endif
+
+    static type lt(type a, type b) { return _mm_cmplt_pd(a, b); }
+    static type le(type a, type b) { return _mm_cmple_pd(a, b); }
+    static type gt(type a, type b) { return _mm_cmpgt_pd(a, b); }
+    static type ge(type a, type b) { return _mm_cmpge_pd(a, b); }
+    static type eq(type a, type b) { return _mm_cmpeq_pd(a, b); }
+    static type ne(type a, type b) { return _mm_cmpneq_pd(a, b); }
+    static unsigned mask(type v) { return static_cast<unsigned>(_mm_movemask_pd(v)); }
+
+    template <std::size_t K>
+    static type down(type v) { return _mm_unpackhi_pd(v, v); }
+
+    static double first(type v) { return _mm_cvtsd_f64(v); }
+};
+
+#endif
+
+#if EE_SIMD >= EE_SIMD_AVX
+
+template <>
+struct Pack<float, 8> {
+    using type = __m256;
+    static constexpr std::size_t width = 8;
+    static constexpr bool has_fma = EE_SIMD_FMA;
+
+    static type load(const float* values) { return _mm256_loadu_ps(values); }
+    static void store(float* values, type v) { _mm256_storeu_ps(values, v); }
+    static type set1(float value) { return _mm256_set1_ps(value); }
+
+    static type add(type a, type b) { return _mm256_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+    static type div(type a, type b) { return _mm256_div_ps(a, b); }
+    static type min(type a, type b) { return _mm256_min_ps(b, a); }
+    static type max(type a, type b) { return _mm256_max_ps(b, a); }
+#if EE_SIMD_FMA
+    static type fma(type a, type b, type c) { return _mm256_fmadd_ps(a, b, c); }
+#endif
+
+    static type lt(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static type le(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static type gt(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static type ge(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static type eq(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static type ne(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+    static unsigned mask(type v) { return static_cast<unsigned>(_mm256_movemask_ps(v)); }
+
+    template <std::size_t K>
+    static type down(type v) {
+        if constexpr (K == 4) { return _mm256_permute2f128_ps(v, v, 1); }
+        else if constexpr (K == 2) { return _mm256_permute_ps(v, _MM_SHUFFLE(1, 0, 3, 2)); }
+        else { return _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1)); }
+    }
+
+    static float first(type v) { return _mm256_cvtss_f32(v); }
+};
+
+template <>
+struct Pack<double, 4> {
+    using type = __m256d;
+    static constexpr std::size_t width = 4;
+    static constexpr bool has_fma = EE_SIMD_FMA;
+
+    static type load(const double* values) { return _mm256_loadu_pd(values); }
+    static void store(double* values, type v) { _mm256_storeu_pd(values, v); }
+    static type set1(double value) { return _mm256_set1_pd(value); }
+
+    static type add(type a, type b) { return _mm256_add_pd(a, b); }
+    static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+    static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+    static type div(type a, type b) { return _mm256_div_pd(a, b); }
+    static type min(type a, type b) { return _mm256_min_pd(b, a); }
+    static type max(type a, type b) { return _mm256_max_pd(b, a); }
+#if EE_SIMD_FMA
+    static type fma(type a, type b, type c) { return _mm256_fmadd_pd(a, b, c); }
+#endif
+
+    static type lt(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static type le(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static type gt(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static type ge(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static type eq(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static type ne(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ); }
+    static unsigned mask(type v) { return static_cast<unsigned>(_mm256_movemask_pd(v)); }
+
+    template <std::size_t K>
+    static type down(type v) {
+        if constexpr (K == 2) { return _mm256_permute2f128_pd(v, v, 1); }
+        else { return _mm256_permute_pd(v, 0x5); }
+    }
+
+    static double first(type v) { return _mm256_cvtsd_f64(v); }
+};
+
+#endif
+
+/**
+ * Widest pack of type T not wider than N, its width being 0 when there is
+ * none.
+ */
+namespace detail {
+
+template <typename T, std::size_t N, std::size_t W>
+struct pack_for_impl {
+    using next = typename pack_for_impl<T, N, W / 2>::type;
+    using type = std::conditional_t<Pack<T, W>::width != 0 && W <= N, Pack<T, W>, next>;
+};
+
+template <typename T, std::size_t N>
+struct pack_for_impl<T, N, 0> {
+    using type = Pack<T, 0>;
+};
+
+} // namespace detail
+
+template <typename T, std::size_t N>
+using pack_for = typename detail::pack_for_impl<T, N, 8>::type;
+
+} // namespace simd
+} // namespace ee
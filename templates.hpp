@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <functional>
 #include <type_traits>
+#include <utility>
 
 namespace ee {
 namespace tutil {
@@ -92,5 +94,19 @@ struct all_same<F, S, Rs...>
 template <typename... Ts>
 constexpr bool all_same = detail::all_same<Ts...>::value;
 
+/**
+ * std::invoke usable in constant expressions, which it is not before C++20,
+ * for anything but pointers to members.
+ */
+template <typename Fn, typename... Args>
+constexpr decltype(auto) invoke(Fn&& fn, Args&&... args) {
+    if constexpr (std::is_member_pointer_v<std::decay_t<Fn>>) {
+        return std::invoke(std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+    else {
+        return std::forward<Fn>(fn)(std::forward<Args>(args)...);
+    }
+}
+
 } // namespace tutil
 } // namespace ee
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * Arena alignment, growth and reuse after reset, the pool's arenas and
+ * WorkerLocal slots per thread_id, both refusing other thread_ids.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "../Arena.hpp"
+#include "../ThreadPool.hpp"
+#include "../WorkerLocal.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::ThreadPool;
+
+// one pass of a workload outgrowing the first chunk
+bool workload(ee::Arena& arena) {
+    std::vector<unsigned char*> blocks;
+    bool aligned = true;
+
+    for (std::size_t i = 0; i < 200; ++ i) {
+        const std::size_t size = 1 + i * 37 % 1000;
+        const std::size_t alignment = std::size_t{1} << (i % 9);
+
+        auto* block = static_cast<unsigned char*>(arena.allocate(size, alignment));
+
+        aligned = aligned && reinterpret_cast<std::uintptr_t>(block) % alignment == 0;
+        std::memset(block, static_cast<int>(i), size);
+        blocks.push_back(block);
+    }
+
+    // no block overwrote another
+    bool intact = true;
+
+    for (std::size_t i = 0; i < blocks.size(); ++ i) {
+        const std::size_t size = 1 + i * 37 % 1000;
+
+        for (std::size_t j = 0; j < size; ++ j) {
+            intact = intact && blocks[i][j] == static_cast<unsigned char>(i);
+        }
+    }
+
+    return aligned && intact;
+}
+
+void arena() {
+    ee::Arena arena(4096);
+
+    EE_CHECK(arena.used() == 0 && arena.capacity() == 0);
+    EE_CHECK(workload(arena));
+    EE_CHECK(arena.used() > 4096);
+
+    const std::size_t capacity = arena.capacity();
+
+    // merged in one chunk, the same workload no longer allocates
+    arena.reset();
+
+    EE_CHECK(arena.used() == 0);
+    EE_CHECK(arena.capacity() == capacity);
+    EE_CHECK(workload(arena));
+    EE_CHECK(arena.capacity() == capacity);
+
+    struct Point {
+        double x, y;
+    };
+
+    const Point* point = arena.make<Point>(Point{1.0, 2.0});
+
+    EE_CHECK(point->x == 1.0 && point->y == 2.0);
+    EE_CHECK(reinterpret_cast<std::uintptr_t>(arena.allocate<double>(3)) % alignof(double) == 0);
+}
+
+void worker_locals() {
+    ThreadPool pool(3);
+    ee::WorkerLocal<std::size_t> counts(pool, 0);
+
+    EE_CHECK(counts.size() == pool.worker_count() + 1);
+
+    ee::TaskGroup group(pool);
+
+    group.run_n(1000, [&](std::size_t thread_id, std::size_t) {
+        ++ counts[thread_id];
+        *pool.arena(thread_id).allocate<std::size_t>() = thread_id;
+    });
+    group.wait();
+
+    EE_CHECK(counts.combine(std::size_t{0}, [](std::size_t a, std::size_t b) { return a + b; }) == 1000);
+
+    counts.reset(1);
+
+    std::size_t slots = 0;
+    counts.for_each([&](std::size_t count) { slots += count; });
+
+    EE_CHECK(slots == counts.size());
+
+    // blocking tasks and thread_ids past the workers have no slot nor arena
+    bool local_refused = false;
+    bool arena_refused = false;
+
+    pool.arun_blocking([&](std::size_t thread_id) {
+        try {
+            ++ counts[thread_id];
+        }
+        catch (const std::out_of_range&) {
+            local_refused = true;
+        }
+
+        try {
+            pool.arena(thread_id);
+        }
+        catch (const std::out_of_range&) {
+            arena_refused = true;
+        }
+    }).get();
+
+    EE_CHECK(local_refused);
+    EE_CHECK(arena_refused);
+
+    bool past_refused = false;
+
+    try {
+        ++ counts[counts.size()];
+    }
+    catch (const std::out_of_range&) {
+        past_refused = true;
+    }
+
+    EE_CHECK(past_refused);
+
+    pool.wait_completion();
+    pool.reset_arenas();
+}
+
+} // namespace
+
+int main() {
+    arena();
+    worker_locals();
+
+    return ee::test::result("arena");
+}
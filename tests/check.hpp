@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+#pragma once
+
+#include <cstdio>
+
+namespace ee {
+namespace test {
+
+inline int failures = 0;
+
+/**
+ * Report the outcome of a test program, its exit code being non-zero when a
+ * check failed.
+ */
+inline int result(const char* name) {
+    if (failures > 0) {
+        std::printf("%s: %d failed checks\n", name, failures);
+        return 1;
+    }
+
+    std::printf("%s: ok\n", name);
+
+    return 0;
+}
+
+} // namespace test
+} // namespace ee
+
+// count and report a failed check without stopping the test program
+#define EE_CHECK(condition) \
+    do { \
+        if ( ! (condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++ ee::test::failures; \
+        } \
+    } while (false)
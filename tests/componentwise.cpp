@@ -0,0 +1,302 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * cwise, its lazy, in place and batch forms, reductions and tests against
+ * plain loops over the components, for tuple sizes and value types taking the
+ * SIMD path or not.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "../componentwise.hpp"
+#include "../parallel.hpp"
+#include "check.hpp"
+
+namespace {
+
+// small non-zero integers, so that SIMD and scalar results compare equal
+template <typename T>
+T sample(std::size_t seed) {
+    T t{};
+
+    for (std::size_t k = 0; k < t.size(); ++ k) {
+        const int value = static_cast<int>((seed * 7 + k * 13) % 16) - 8;
+
+        t[k] = static_cast<typename T::value_type>(value >= 0 ? value + 1 : value);
+    }
+
+    return t;
+}
+
+template <typename T>
+T filled(typename T::value_type value) {
+    T t{};
+
+    for (auto& component : t) {
+        component = value;
+    }
+
+    return t;
+}
+
+template <typename T, typename Fn>
+T loop(Fn fn, const T& a, const T& b) {
+    T r{};
+
+    for (std::size_t k = 0; k < r.size(); ++ k) {
+        r[k] = fn(a[k], b[k]);
+    }
+
+    return r;
+}
+
+template <typename T>
+void against_loops() {
+    using V = typename T::value_type;
+
+    for (std::size_t seed = 0; seed < 32; ++ seed) {
+        const T a = sample<T>(seed);
+        const T b = sample<T>(seed * 3 + 1);
+        const T c = sample<T>(seed + 5);
+
+        EE_CHECK(ee::cwise(std::plus<>{}, a, b) == loop(std::plus<>{}, a, b));
+        EE_CHECK(ee::cwise(std::minus<>{}, a, b) == loop(std::minus<>{}, a, b));
+        EE_CHECK(ee::cwise(std::multiplies<>{}, a, b) == loop(std::multiplies<>{}, a, b));
+        EE_CHECK(ee::cwise(std::divides<>{}, a, b) == loop(std::divides<>{}, a, b));
+        EE_CHECK(ee::cwise(ee::ops::min{}, a, b) == loop(ee::ops::min{}, a, b));
+        EE_CHECK(ee::cwise(ee::ops::max{}, a, b) == loop(ee::ops::max{}, a, b));
+
+        // scalars broadcast on either side
+        EE_CHECK(ee::cwise(std::multiplies<>{}, a, V(3)) == loop(std::multiplies<>{}, a, filled<T>(3)));
+        EE_CHECK(ee::cwise(std::minus<>{}, V(2), b) == loop(std::minus<>{}, filled<T>(2), b));
+
+        T fma{};
+
+        for (std::size_t k = 0; k < fma.size(); ++ k) {
+            fma[k] = ee::ops::fma{}(a[k], b[k], c[k]);
+        }
+
+        EE_CHECK(ee::cwise(ee::ops::fma{}, a, b, c) == fma);
+
+        const auto less = ee::cwise(std::less<>{}, a, b);
+
+        for (std::size_t k = 0; k < a.size(); ++ k) {
+            EE_CHECK(less[k] == (a[k] < b[k]));
+        }
+
+        T assigned = a;
+        ee::add_assign(assigned, b);
+
+        EE_CHECK(assigned == loop(std::plus<>{}, a, b));
+
+        ee::cwise_assign(ee::ops::fma{}, assigned, a, b, c);
+
+        EE_CHECK(assigned == fma);
+
+        ee::cwise_assign(std::plus<>{}, assigned, ee::cwise_lazy(std::multiplies<>{}, a, b), c);
+
+        EE_CHECK(assigned == loop(std::plus<>{}, loop(std::multiplies<>{}, a, b), c));
+    }
+}
+
+// expression trees evaluate as the nested cwise calls they stand for
+template <typename T>
+void lazy() {
+    using V = typename T::value_type;
+
+    for (std::size_t seed = 0; seed < 32; ++ seed) {
+        const T a = sample<T>(seed);
+        const T b = sample<T>(seed * 3 + 1);
+        const T c = sample<T>(seed + 5);
+
+        const T sum = ee::cwise_lazy(std::plus<>{}, a, b);
+
+        EE_CHECK(sum == loop(std::plus<>{}, a, b));
+
+        const auto tree = ee::cwise_lazy(ee::ops::fma{},
+                                         ee::cwise_lazy(std::minus<>{}, a, b),
+                                         V(2),
+                                         ee::cwise_lazy(ee::ops::max{}, c, ee::cwise_lazy(std::multiplies<>{}, a, V(3))));
+        const T expected = ee::cwise(ee::ops::fma{},
+                                     ee::cwise(std::minus<>{}, a, b),
+                                     V(2),
+                                     ee::cwise(ee::ops::max{}, c, ee::cwise(std::multiplies<>{}, a, V(3))));
+
+        EE_CHECK(tree.eval() == expected);
+
+        for (std::size_t k = 0; k < a.size(); ++ k) {
+            EE_CHECK(tree[k] == expected[k]);
+        }
+
+        // a comparison at the root, a callable stopping vectorization
+        const auto less = ee::cwise_lazy(std::less<>{}, ee::cwise_lazy(std::plus<>{}, a, b), c).eval();
+        const T absolute = ee::cwise_lazy([](V x) { return x < 0 ? -x : x; }, ee::cwise_lazy(std::minus<>{}, a, b));
+
+        for (std::size_t k = 0; k < a.size(); ++ k) {
+            EE_CHECK(less[k] == (a[k] + b[k] < c[k]));
+            EE_CHECK(absolute[k] == (a[k] < b[k] ? b[k] - a[k] : a[k] - b[k]));
+        }
+
+        // rvalue operands are held by the node
+        const T held = ee::cwise_lazy(std::plus<>{}, sample<T>(seed), ee::cwise_lazy(std::negate<>{}, sample<T>(seed)));
+
+        EE_CHECK(held == filled<T>(0));
+    }
+}
+
+// small integer components, so every reduction order gives the same result
+template <typename T>
+void reductions() {
+    using V = typename T::value_type;
+
+    for (std::size_t seed = 0; seed < 32; ++ seed) {
+        const T a = sample<T>(seed);
+        const T b = sample<T>(seed * 3 + 1);
+
+        V sum = 0;
+        V product = 1;
+        V min = a[0];
+        V max = a[0];
+        V dot = 0;
+
+        for (std::size_t k = 0; k < a.size(); ++ k) {
+            sum += a[k];
+            product *= a[k];
+            min = std::min(min, a[k]);
+            max = std::max(max, a[k]);
+            dot += a[k] * b[k];
+        }
+
+        EE_CHECK(ee::hsum(a) == sum);
+        EE_CHECK(ee::cwise_reduce(std::multiplies<>{}, a) == product);
+        EE_CHECK(ee::hmin(a) == min);
+        EE_CHECK(ee::hmax(a) == max);
+        EE_CHECK(ee::dot(a, b) == dot);
+
+        // a callable cwise_reduce does not vectorize
+        EE_CHECK(ee::cwise_reduce([](V x, V y) { return x + y; }, a) == sum);
+
+        bool all_less = true;
+        bool any_less = false;
+        bool all_positive = true;
+        bool any_positive = false;
+
+        for (std::size_t k = 0; k < a.size(); ++ k) {
+            all_less = all_less && a[k] < b[k];
+            any_less = any_less || a[k] < b[k];
+            all_positive = all_positive && a[k] > 0;
+            any_positive = any_positive || a[k] > 0;
+        }
+
+        EE_CHECK(ee::all_of(std::less<>{}, a, b) == all_less);
+        EE_CHECK(ee::any_of(std::less<>{}, a, b) == any_less);
+        EE_CHECK(ee::all_of(std::greater<>{}, a, V(0)) == all_positive);
+        EE_CHECK(ee::any_of(std::greater<>{}, a, V(0)) == any_positive);
+        EE_CHECK(ee::all_of(ee::cwise(std::less<>{}, a, b)) == all_less);
+        EE_CHECK(ee::any_of(ee::cwise(std::less<>{}, a, b)) == any_less);
+    }
+
+    // the deciding component last, past every full pack
+    T t = filled<T>(1);
+
+    EE_CHECK(ee::all_of(std::equal_to<>{}, t, V(1)));
+    EE_CHECK( ! ee::any_of(std::equal_to<>{}, t, V(2)));
+
+    t[t.size() - 1] = 2;
+
+    EE_CHECK( ! ee::all_of(std::equal_to<>{}, t, V(1)));
+    EE_CHECK(ee::any_of(std::equal_to<>{}, t, V(2)));
+}
+
+// batch forms match cwise called on every element
+template <typename T>
+void batches(ee::ThreadPool& pool) {
+    for (std::size_t count : {0, 1, 7, 8, 9, 255, 256, 257, 10000}) {
+        std::vector<T> a(count);
+        std::vector<T> b(count);
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            a[i] = sample<T>(i);
+            b[i] = sample<T>(i * 3 + 1);
+        }
+
+        std::vector<T> out(count);
+
+        ee::cwise_batch(ee::ops::fma{}, out, a, b, a);
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            EE_CHECK(out[i] == ee::cwise(ee::ops::fma{}, a[i], b[i], a[i]));
+        }
+
+        ee::par::cwise_batch(pool, std::minus<>{}, out, a, b);
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            EE_CHECK(out[i] == ee::cwise(std::minus<>{}, a[i], b[i]));
+        }
+
+        // out as an argument, a tuple broadcast
+        ee::cwise_batch(std::multiplies<>{}, out, out, filled<T>(2));
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            EE_CHECK(out[i] == ee::cwise(std::multiplies<>{}, ee::cwise(std::minus<>{}, a[i], b[i]), filled<T>(2)));
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    against_loops<std::array<float, 2>>();
+    against_loops<std::array<float, 3>>();
+    against_loops<std::array<float, 4>>();
+    against_loops<std::array<float, 8>>();
+    against_loops<std::array<double, 2>>();
+    against_loops<std::array<double, 4>>();
+    against_loops<std::array<double, 5>>();
+    against_loops<std::array<int, 4>>();
+    against_loops<std::array<int, 7>>();
+
+    lazy<std::array<float, 2>>();
+    lazy<std::array<float, 3>>();
+    lazy<std::array<float, 4>>();
+    lazy<std::array<float, 8>>();
+    lazy<std::array<double, 2>>();
+    lazy<std::array<double, 4>>();
+    lazy<std::array<double, 5>>();
+    lazy<std::array<int, 4>>();
+    lazy<std::array<int, 7>>();
+
+    static_assert(ee::cwise_lazy(std::plus<>{}, std::array<int, 2>{1, 2}, 3)[1] == 5);
+
+    reductions<std::array<float, 2>>();
+    reductions<std::array<float, 3>>();
+    reductions<std::array<float, 4>>();
+    reductions<std::array<float, 8>>();
+    reductions<std::array<double, 2>>();
+    reductions<std::array<double, 4>>();
+    reductions<std::array<double, 5>>();
+    reductions<std::array<int, 4>>();
+    reductions<std::array<int, 7>>();
+
+    static_assert(ee::hsum(std::array<int, 3>{1, 2, 3}) == 6);
+    static_assert(ee::dot(std::array<int, 3>{1, 2, 3}, std::array<int, 3>{4, 5, 6}) == 32);
+    static_assert(ee::all_of(std::less<>{}, std::array<int, 2>{1, 2}, 3));
+
+    ee::ThreadPool pool(3);
+
+    batches<std::array<float, 3>>(pool);
+    batches<std::array<float, 4>>(pool);
+    batches<std::array<double, 4>>(pool);
+    batches<std::array<int, 4>>(pool);
+
+    return ee::test::result("componentwise");
+}
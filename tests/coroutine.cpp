@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * CoTask with pool.schedule(): resuming on pool threads, when_all results in
+ * order, exceptions reaching sync_wait, coroutines dropped by join(Discard).
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../Coroutine.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::CoTask;
+using ee::ThreadPool;
+
+CoTask<std::size_t> on_pool(ThreadPool& pool) {
+    co_return co_await pool.schedule();
+}
+
+CoTask<int> square(ThreadPool& pool, int i) {
+    co_await pool.schedule();
+    co_return i * i;
+}
+
+CoTask<int> sum_of_squares(ThreadPool& pool, int count) {
+    std::vector<CoTask<int>> tasks;
+
+    for (int i = 0; i < count; ++ i) {
+        tasks.push_back(square(pool, i));
+    }
+
+    const auto squares = co_await ee::when_all(std::move(tasks));
+    int sum = 0;
+
+    for (int i = 0; i < count; ++ i) {
+        EE_CHECK(squares[i] == i * i);
+        sum += squares[i];
+    }
+
+    co_return sum;
+}
+
+CoTask<void> failing(ThreadPool& pool) {
+    co_await pool.schedule();
+    throw std::runtime_error("failing");
+}
+
+void scheduling() {
+    ThreadPool pool(3);
+
+    for (int i = 0; i < 20; ++ i) {
+        EE_CHECK(ee::sync_wait(on_pool(pool)) < pool.worker_count());
+    }
+
+    EE_CHECK(ee::sync_wait(sum_of_squares(pool, 100)) == 328350);
+
+    bool thrown = false;
+
+    try {
+        ee::sync_wait(failing(pool));
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+
+    EE_CHECK(thrown);
+}
+
+// a coroutine queued on a held lane is resumed with Cancelled as it is dropped
+void discarded() {
+    ThreadPool pool(2);
+    pool.set_lane_budget(ThreadPool::Priority::Normal, 0);
+
+    std::atomic<bool> scheduling{false};
+    std::atomic<bool> resumed{false};
+    bool cancelled = false;
+
+    auto task = [&]() -> CoTask<void> {
+        scheduling = true;
+        co_await pool.schedule();
+        resumed = true;
+    };
+
+    std::thread waiter([&] {
+        try {
+            ee::sync_wait(task());
+        }
+        catch (const ee::Cancelled&) {
+            cancelled = true;
+        }
+    });
+
+    while ( ! scheduling) {
+        std::this_thread::yield();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    pool.join(ThreadPool::JoinMode::Discard);
+    waiter.join();
+
+    EE_CHECK(cancelled);
+    EE_CHECK( ! resumed);
+}
+
+} // namespace
+
+int main() {
+    scheduling();
+    discarded();
+
+    return ee::test::result("coroutine");
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * Histogram buckets and percentiles, trace rings keeping the last events,
+ * pool statistics and Chrome trace output, or their absence when
+ * EE_THREADPOOL_INSTRUMENT is not set.
+ */
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../Instrumentation.hpp"
+#include "../ThreadPool.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::ThreadPool;
+
+std::size_t occurrences(const std::string& text, const std::string& pattern) {
+    std::size_t count = 0;
+
+    for (auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+        ++ count;
+    }
+
+    return count;
+}
+
+void histograms() {
+    ee::detail::HistogramCounters counters;
+
+    for (std::uint64_t value : {0, 1, 2, 3, 4, 1000}) {
+        counters.record(value);
+    }
+
+    const ee::Histogram histogram = counters.snapshot();
+
+    EE_CHECK(histogram.count == 6);
+    EE_CHECK(histogram.sum == 1010);
+    EE_CHECK(histogram.max == 1000);
+    EE_CHECK(histogram.buckets[0] == 1 && histogram.buckets[1] == 1 && histogram.buckets[2] == 2);
+    EE_CHECK(histogram.buckets[3] == 1 && histogram.buckets[10] == 1);
+    EE_CHECK(histogram.mean() > 168.3 && histogram.mean() < 168.4);
+    EE_CHECK(histogram.percentile(0.0) == 0);
+    EE_CHECK(histogram.percentile(0.5) == 3);
+    EE_CHECK(histogram.percentile(1.0) == 1000);
+
+    counters.reset();
+
+    EE_CHECK(counters.snapshot().count == 0);
+    EE_CHECK(counters.snapshot().percentile(0.5) == 0);
+}
+
+void trace_rings() {
+    ee::detail::TraceRing ring;
+    std::vector<std::int64_t> starts;
+
+    ring.record({1, 1, 0, false});
+    ring.for_each([&](const ee::detail::TraceEvent& event) { starts.push_back(event.start); });
+
+    EE_CHECK(starts.empty());
+
+    ring.resize(3);
+
+    for (std::int64_t i = 0; i < 5; ++ i) {
+        ring.record({i, 1, 0, i % 2 == 0});
+    }
+
+    ring.for_each([&](const ee::detail::TraceEvent& event) { starts.push_back(event.start); });
+
+    EE_CHECK(starts == std::vector<std::int64_t>({2, 3, 4}));
+
+    std::ostringstream out;
+    ee::detail::write_chrome_trace(out, {&ring}, 0);
+
+    EE_CHECK(occurrences(out.str(), "\"ph\":\"X\"") == 3);
+    EE_CHECK(occurrences(out.str(), "\"name\":\"idle\"") == 2);
+    EE_CHECK(occurrences(out.str(), "\"thread_name\"") == 1);
+}
+
+void pool_statistics() {
+    ThreadPool pool(2);
+
+    pool.enable_trace(1024);
+
+    ee::TaskGroup group(pool);
+
+    group.run_n(100, [](std::size_t, std::size_t) {});
+    group.wait();
+    pool.wait_completion();
+
+    const auto stats = pool.stats();
+
+    EE_CHECK(stats.size() == pool.worker_count() + 1);
+
+    std::uint64_t tasks = 0;
+
+    for (const ee::WorkerStats& worker : stats) {
+        tasks += worker.tasks;
+        EE_CHECK(worker.run_ns.count == worker.tasks);
+        EE_CHECK(worker.wait_ns.count == worker.tasks);
+    }
+
+    std::ostringstream out;
+    pool.write_trace(out);
+
+    EE_CHECK(occurrences(out.str(), "\"thread_name\"") == pool.worker_count() + 1);
+
+#if EE_THREADPOOL_INSTRUMENT
+    EE_CHECK(tasks == 100);
+    EE_CHECK(occurrences(out.str(), "\"name\":\"task\"") == 100);
+#else
+    EE_CHECK(tasks == 0);
+    EE_CHECK(occurrences(out.str(), "\"ph\":\"X\"") == 0);
+#endif
+
+    pool.reset_stats();
+
+    tasks = 0;
+
+    for (const ee::WorkerStats& worker : pool.stats()) {
+        tasks += worker.tasks;
+    }
+
+    EE_CHECK(tasks == 0);
+
+    pool.enable_trace(0);
+}
+
+} // namespace
+
+int main() {
+    histograms();
+    trace_rings();
+    pool_statistics();
+
+    return ee::test::result("instrumentation");
+}
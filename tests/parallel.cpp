@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * par:: algorithms against their std:: counterparts, for sizes below, at and
+ * well past one block per thread.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+#include "../parallel.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::ThreadPool;
+
+std::vector<std::int64_t> values(std::size_t count) {
+    std::vector<std::int64_t> v(count);
+    std::uint32_t state = 12345;
+
+    for (auto& value : v) {
+        state = state * 1664525u + 1013904223u;
+        value = static_cast<std::int64_t>(state >> 20) - 2048;
+    }
+
+    return v;
+}
+
+void against_std(ThreadPool& pool, std::size_t count) {
+    const auto v = values(count);
+    const auto odd = [](std::int64_t x) { return x % 2 != 0; };
+    const auto square = [](std::int64_t x) { return x * x; };
+    const auto max = [](std::int64_t a, std::int64_t b) { return std::max(a, b); };
+
+    EE_CHECK(ee::par::reduce(pool, v.begin(), v.end(), std::int64_t{7}) ==
+             std::accumulate(v.begin(), v.end(), std::int64_t{7}));
+    EE_CHECK(ee::par::reduce(pool, v.begin(), v.end(), std::int64_t{-5000}, max) ==
+             std::accumulate(v.begin(), v.end(), std::int64_t{-5000}, max));
+    EE_CHECK(ee::par::transform_reduce(pool, v.begin(), v.end(), std::int64_t{0}, std::plus<>{}, square) ==
+             std::transform_reduce(v.begin(), v.end(), std::int64_t{0}, std::plus<>{}, square));
+
+    std::vector<std::int64_t> expected(count);
+    std::vector<std::int64_t> got(count);
+
+    std::inclusive_scan(v.begin(), v.end(), expected.begin());
+    EE_CHECK(ee::par::inclusive_scan(pool, v.begin(), v.end(), got.begin()) == got.end());
+    EE_CHECK(got == expected);
+
+    std::exclusive_scan(v.begin(), v.end(), expected.begin(), std::int64_t{3});
+    EE_CHECK(ee::par::exclusive_scan(pool, v.begin(), v.end(), got.begin(), std::int64_t{3}) == got.end());
+    EE_CHECK(got == expected);
+
+    // in place, as std allows
+    got = v;
+    expected = v;
+    std::inclusive_scan(expected.begin(), expected.end(), expected.begin(), max);
+    ee::par::inclusive_scan(pool, got.begin(), got.end(), got.begin(), max);
+    EE_CHECK(got == expected);
+
+    got = v;
+    expected = v;
+    std::sort(expected.begin(), expected.end());
+    ee::par::sort(pool, got.begin(), got.end());
+    EE_CHECK(got == expected);
+
+    got = v;
+    std::sort(expected.begin(), expected.end(), std::greater<>{});
+    ee::par::sort(pool, got.begin(), got.end(), std::greater<>{});
+    EE_CHECK(got == expected);
+
+    got = v;
+    expected = v;
+    const auto expected_split = std::stable_partition(expected.begin(), expected.end(), odd) - expected.begin();
+    const auto split = ee::par::partition(pool, got.begin(), got.end(), odd) - got.begin();
+    EE_CHECK(split == expected_split);
+    EE_CHECK(got == expected);
+
+    got = v;
+    expected = v;
+    ee::par::for_each(pool, got.begin(), got.end(), [](std::int64_t& x) { x = x * 3 + 1; });
+    std::for_each(expected.begin(), expected.end(), [](std::int64_t& x) { x = x * 3 + 1; });
+    EE_CHECK(got == expected);
+}
+
+} // namespace
+
+int main() {
+    for (std::size_t workers : {1, 3}) {
+        ThreadPool pool(workers);
+
+        for (std::size_t count : {0, 1, 2, 3, 17, 1000, 100003}) {
+            against_std(pool, count);
+        }
+    }
+
+    return ee::test::result("parallel");
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * parallel_pipeline: in order stages seeing items in source order, serial
+ * stages one item at a time, at most max_tokens items in flight, exceptions
+ * stopping the source and reaching the caller.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../Pipeline.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::StageMode;
+using ee::ThreadPool;
+
+// raise the running count of a stage and keep its highest value
+class Occupancy {
+    public:
+        explicit Occupancy(std::atomic<int>& running, std::atomic<int>& most) :
+            running_{running} {
+            const int now = ++ running_;
+            int seen = most;
+
+            while (now > seen && ! most.compare_exchange_weak(seen, now)) {}
+        }
+
+        ~Occupancy() {
+            -- running_;
+        }
+
+    private:
+        std::atomic<int>& running_;
+};
+
+void ordering(ThreadPool& pool, std::size_t tokens, int count) {
+    int next = 0;
+    std::vector<int> out;
+    std::atomic<int> parallel_running{0};
+    std::atomic<int> parallel_most{0};
+    std::atomic<int> serial_running{0};
+    std::atomic<int> serial_most{0};
+    std::atomic<int> unordered{0};
+
+    ee::parallel_pipeline(pool, tokens,
+        ee::make_stage(StageMode::SerialInOrder, [&](std::size_t, ee::FlowControl& flow) {
+            if (next == count) {
+                flow.stop();
+            }
+
+            return next ++;
+        }),
+        ee::make_stage(StageMode::Parallel, [&](std::size_t, int i) {
+            Occupancy occupancy(parallel_running, parallel_most);
+
+            // later items finish first now and then
+            if (i % 7 == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+
+            return i * 2;
+        }),
+        ee::make_stage(StageMode::SerialOutOfOrder, [&](std::size_t, int i) {
+            Occupancy occupancy(serial_running, serial_most);
+
+            ++ unordered;
+
+            return i;
+        }),
+        ee::make_stage(StageMode::SerialInOrder, [&](std::size_t, int i) {
+            out.push_back(i);
+        }));
+
+    bool ordered = static_cast<int>(out.size()) == count;
+
+    for (int i = 0; ordered && i < count; ++ i) {
+        ordered = out[i] == i * 2;
+    }
+
+    EE_CHECK(ordered);
+    EE_CHECK(unordered == count);
+    EE_CHECK(parallel_most <= static_cast<int>(tokens));
+    EE_CHECK(serial_most <= 1);
+}
+
+void failures(ThreadPool& pool) {
+    int next = 0;
+    std::atomic<int> seen{0};
+    bool thrown = false;
+
+    try {
+        ee::parallel_pipeline(pool, 4,
+            ee::make_stage(StageMode::SerialInOrder, [&](std::size_t, ee::FlowControl& flow) {
+                if (next == 1000000) {
+                    flow.stop();
+                }
+
+                return next ++;
+            }),
+            ee::make_stage(StageMode::Parallel, [&](std::size_t, int i) {
+                ++ seen;
+
+                if (i == 50) {
+                    throw std::runtime_error("stage");
+                }
+            }));
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+
+    EE_CHECK(thrown);
+    EE_CHECK(next < 1000000);
+    EE_CHECK(seen < 1000000);
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(4);
+
+    for (std::size_t tokens : {1, 2, 8}) {
+        for (int count : {0, 1, 500}) {
+            ordering(pool, tokens, count);
+        }
+    }
+
+    failures(pool);
+
+    return ee::test::result("pipeline");
+}
@@ -0,0 +1,323 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * split_for under every schedule and TaskGroup: each index visited once,
+ * cancellation, loops run by several outside threads and from pool tasks,
+ * exceptions reaching the waiter. split_for_2d and split_for_3d tiles
+ * covering their grid in every order.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../ThreadPool.hpp"
+#include "../TiledFor.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::Schedule;
+using ee::ThreadPool;
+
+constexpr Schedule schedules[] = {Schedule::Static, Schedule::Dynamic, Schedule::Guided};
+
+// every j = i * stride for i in [0, count) is visited exactly once
+void coverage(ThreadPool& pool, Schedule schedule) {
+    const std::size_t counts[] = {0, 1, 2, 7, 100, 1000, 4097};
+    const std::size_t splits[] = {0, 1, 3, 8, 64, 5000};
+    const std::size_t at_leasts[] = {0, 1, 16, 10000};
+
+    for (std::size_t count : counts) {
+        for (std::size_t stride : {1, 3}) {
+            for (std::size_t split : splits) {
+                for (std::size_t at_least : at_leasts) {
+                    std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count * stride + 1]());
+                    std::atomic<bool> bad_thread_id{false};
+
+                    ee::split_for(pool, count, stride, split, at_least, schedule, [&](std::size_t thread_id, std::size_t j) {
+                        if (thread_id > pool.worker_count()) {
+                            bad_thread_id = true;
+                        }
+
+                        ++ visits[j];
+                    });
+
+                    bool once = true;
+
+                    for (std::size_t j = 0; j < count * stride; ++ j) {
+                        once = once && visits[j] == (j % stride == 0 ? 1 : 0);
+                    }
+
+                    EE_CHECK(once);
+                    EE_CHECK( ! bad_thread_id);
+                }
+            }
+        }
+    }
+}
+
+void cancellation(ThreadPool& pool, Schedule schedule) {
+    ee::CancelToken token;
+    std::atomic<std::size_t> visited{0};
+
+    const bool complete = ee::split_for(pool, 100000, 1, 8, 16, schedule, token, [&](std::size_t, std::size_t) {
+        if (++ visited == 100) {
+            token.cancel();
+        }
+    });
+
+    EE_CHECK( ! complete);
+    EE_CHECK(visited < 100000);
+
+    ee::CancelToken idle;
+    visited = 0;
+
+    EE_CHECK(ee::split_for(pool, 1000, 1, 8, 16, schedule, idle, [&](std::size_t, std::size_t) { ++ visited; }));
+    EE_CHECK(visited == 1000);
+}
+
+// loops from several outside threads and from within pool tasks
+void concurrent_loops(ThreadPool& pool, Schedule schedule) {
+    std::atomic<std::size_t> sum{0};
+    std::vector<std::thread> callers;
+
+    for (int t = 0; t < 3; ++ t) {
+        callers.emplace_back([&] {
+            for (int round = 0; round < 20; ++ round) {
+                ee::split_for(pool, 1000, 1, 8, 4, schedule, [&](std::size_t, std::size_t j) { sum += j; });
+            }
+        });
+    }
+
+    for (auto& caller : callers) {
+        caller.join();
+    }
+
+    EE_CHECK(sum == 3 * 20 * (999 * 1000 / 2));
+
+    sum = 0;
+
+    ee::split_for(pool, 16, 1, 16, 1, schedule, [&](std::size_t, std::size_t) {
+        ee::split_for(pool, 100, 1, 4, 1, schedule, [&](std::size_t, std::size_t j) { sum += j; });
+    });
+
+    EE_CHECK(sum == 16 * (99 * 100 / 2));
+}
+
+void task_groups(ThreadPool& pool) {
+    {
+        ee::TaskGroup group(pool);
+        std::atomic<int> ran{0};
+
+        for (int i = 0; i < 50; ++ i) {
+            group.run([&](std::size_t) { ++ ran; });
+        }
+
+        group.run_n(50, [&](std::size_t, std::size_t) { ++ ran; });
+        group.wait();
+
+        EE_CHECK(ran == 100);
+
+        // reused once waited for, tasks adding more tasks to their own group
+        group.run([&](std::size_t) {
+            group.run([&](std::size_t) { ++ ran; });
+        });
+        group.wait();
+
+        EE_CHECK(ran == 101);
+    }
+
+    {
+        ee::TaskGroup group(pool);
+        std::atomic<int> ran{0};
+
+        group.run_n(20, [&](std::size_t, std::size_t i) {
+            ++ ran;
+
+            if (i == 7) {
+                throw std::runtime_error("task 7");
+            }
+        });
+
+        bool thrown = false;
+
+        try {
+            group.wait();
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+
+        EE_CHECK(thrown);
+        EE_CHECK(ran == 20);
+    }
+}
+
+// every cell of a grid in exactly one tile, tiles within the grid and the
+// requested extents
+template <std::size_t N, typename Split>
+void tile_coverage(const std::array<std::size_t, N>& size, const std::array<std::size_t, N>& extent, Split split) {
+    std::size_t cells = 1;
+
+    for (std::size_t d = 0; d < N; ++ d) {
+        cells *= size[d];
+    }
+
+    std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[cells + 1]());
+    std::atomic<bool> bad_tile{false};
+
+    split([&](std::size_t, const ee::Tile<N>& tile) {
+        std::array<std::size_t, N> at = tile.begin;
+
+        for (std::size_t d = 0; d < N; ++ d) {
+            if (tile.begin[d] >= tile.end[d] || tile.end[d] > size[d] ||
+                (extent[d] > 0 && tile.end[d] - tile.begin[d] > extent[d])) {
+                bad_tile = true;
+                return;
+            }
+        }
+
+        // walk the tile's cells, x first
+        for (;;) {
+            std::size_t cell = 0;
+
+            for (std::size_t d = N; d -- > 0;) {
+                cell = cell * size[d] + at[d];
+            }
+
+            ++ visits[cell];
+
+            std::size_t d = 0;
+
+            while (d < N && ++ at[d] == tile.end[d]) {
+                at[d] = tile.begin[d];
+                ++ d;
+            }
+
+            if (d == N) {
+                break;
+            }
+        }
+    });
+
+    bool once = true;
+
+    for (std::size_t cell = 0; cell < cells; ++ cell) {
+        once = once && visits[cell] == 1;
+    }
+
+    EE_CHECK(once);
+    EE_CHECK( ! bad_tile);
+}
+
+void tiled(ThreadPool& pool) {
+    for (ee::TileOrder order : {ee::TileOrder::RowMajor, ee::TileOrder::Morton, ee::TileOrder::Hilbert}) {
+        for (std::size_t width : {0, 1, 37, 256}) {
+            tile_coverage<2>({width, 45}, {16, 8}, [&](auto fn) {
+                ee::split_for_2d(pool, width, 45, 16, 8, order, fn);
+            });
+        }
+
+        tile_coverage<3>({33, 20, 9}, {8, 8, 4}, [&](auto fn) {
+            ee::split_for_3d(pool, 33, 20, 9, 8, 8, 4, order, fn);
+        });
+    }
+
+    // cache sized tiles, at most 32 KiB of items
+    tile_coverage<2>({1000, 700}, {64, 64}, [&](auto fn) {
+        ee::split_for_2d(pool, 1000, 700, 8, fn);
+    });
+
+    tile_coverage<3>({100, 70, 50}, {16, 16, 16}, [&](auto fn) {
+        ee::split_for_3d(pool, 100, 70, 50, 8, fn);
+    });
+}
+
+// Morton and Hilbert keys number the cells of a 2^bits sided grid, Hilbert
+// neighbours along the curve being neighbours on the grid
+template <std::size_t N>
+void tile_orders(unsigned bits) {
+    const std::size_t side = std::size_t{1} << bits;
+    const std::size_t cells = std::size_t{1} << (bits * N);
+
+    std::vector<std::array<std::uint32_t, N>> by_hilbert(cells);
+    std::vector<bool> morton_seen(cells, false);
+    std::vector<bool> hilbert_seen(cells, false);
+    bool in_range = true;
+
+    for (std::size_t index = 0; index < cells; ++ index) {
+        std::array<std::uint32_t, N> coords;
+        std::size_t rest = index;
+
+        for (std::size_t d = 0; d < N; ++ d) {
+            coords[d] = static_cast<std::uint32_t>(rest % side);
+            rest /= side;
+        }
+
+        const auto morton = ee::detail::morton_key(coords, bits);
+        const auto hilbert = ee::detail::hilbert_key(coords, bits);
+
+        in_range = in_range && morton < cells && hilbert < cells;
+
+        if (in_range) {
+            morton_seen[morton] = true;
+            hilbert_seen[hilbert] = true;
+            by_hilbert[hilbert] = coords;
+        }
+    }
+
+    EE_CHECK(in_range);
+    EE_CHECK(std::count(morton_seen.begin(), morton_seen.end(), true) == static_cast<std::ptrdiff_t>(cells));
+    EE_CHECK(std::count(hilbert_seen.begin(), hilbert_seen.end(), true) == static_cast<std::ptrdiff_t>(cells));
+
+    bool adjacent = true;
+
+    for (std::size_t i = 1; i < cells; ++ i) {
+        std::size_t distance = 0;
+
+        for (std::size_t d = 0; d < N; ++ d) {
+            distance += by_hilbert[i][d] > by_hilbert[i - 1][d] ?
+                        by_hilbert[i][d] - by_hilbert[i - 1][d] :
+                        by_hilbert[i - 1][d] - by_hilbert[i][d];
+        }
+
+        adjacent = adjacent && distance == 1;
+    }
+
+    EE_CHECK(adjacent);
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(4);
+
+    for (Schedule schedule : schedules) {
+        coverage(pool, schedule);
+        cancellation(pool, schedule);
+        concurrent_loops(pool, schedule);
+    }
+
+    task_groups(pool);
+    tiled(pool);
+
+    // x least significant in Morton order
+    EE_CHECK(ee::detail::morton_key<2>({1, 0}, 1) == 1 && ee::detail::morton_key<2>({0, 1}, 1) == 2);
+
+    tile_orders<2>(1);
+    tile_orders<2>(4);
+    tile_orders<3>(3);
+
+    return ee::test::result("split_for");
+}
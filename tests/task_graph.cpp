@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * TaskGraph: every node once per run after all its predecessors, repeated
+ * runs, cycles refused, a throwing node skipping its successors.
+ */
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../TaskGraph.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::TaskGraph;
+using ee::ThreadPool;
+
+// a layered graph, each node after a few nodes of the layers before
+void ordering(ThreadPool& pool) {
+    constexpr std::size_t count = 500;
+
+    TaskGraph graph;
+    std::atomic<std::size_t> clock{0};
+    std::unique_ptr<std::atomic<std::size_t>[]> finished(new std::atomic<std::size_t>[count]());
+    std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[count]());
+    std::vector<std::pair<std::size_t, std::size_t>> edges;
+
+    for (std::size_t i = 0; i < count; ++ i) {
+        graph.add([&, i](std::size_t) {
+            ++ runs[i];
+            finished[i] = ++ clock;
+        });
+    }
+
+    for (std::size_t i = 1; i < count; ++ i) {
+        for (std::size_t before : {i / 2, i * 7 / 10, i - 1}) {
+            graph.precede(before, i);
+            edges.emplace_back(before, i);
+        }
+    }
+
+    EE_CHECK(graph.node_count() == count);
+
+    for (int run = 1; run <= 3; ++ run) {
+        clock = 0;
+        graph.run(pool);
+
+        bool once = true;
+        bool ordered = true;
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            once = once && runs[i] == run;
+        }
+
+        for (const auto& edge : edges) {
+            ordered = ordered && finished[edge.first] < finished[edge.second];
+        }
+
+        EE_CHECK(once);
+        EE_CHECK(ordered);
+    }
+
+    graph.clear();
+
+    EE_CHECK(graph.node_count() == 0);
+
+    graph.run(pool);
+}
+
+void cycles(ThreadPool& pool) {
+    TaskGraph graph;
+    std::atomic<int> ran{0};
+
+    const auto a = graph.add([&](std::size_t) { ++ ran; });
+    const auto b = graph.add([&](std::size_t) { ++ ran; });
+    const auto c = graph.add([&](std::size_t) { ++ ran; });
+
+    graph.precede(a, b);
+    graph.precede(b, c);
+    graph.precede(c, b);
+
+    bool refused = false;
+
+    try {
+        graph.run(pool);
+    }
+    catch (const std::logic_error&) {
+        refused = true;
+    }
+
+    EE_CHECK(refused);
+    EE_CHECK(ran == 0);
+}
+
+void failures(ThreadPool& pool) {
+    TaskGraph graph;
+    std::atomic<bool> successor_ran{false};
+    std::atomic<bool> sibling_ran{false};
+
+    const auto root = graph.add([](std::size_t) {});
+    const auto failing = graph.add([](std::size_t) { throw std::runtime_error("node"); });
+    const auto successor = graph.add([&](std::size_t) { successor_ran = true; });
+    const auto sibling = graph.add([&](std::size_t) { sibling_ran = true; });
+
+    graph.precede(root, failing);
+    graph.precede(failing, successor);
+    graph.precede(root, sibling);
+
+    bool thrown = false;
+
+    try {
+        graph.run(pool);
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+
+    EE_CHECK(thrown);
+    EE_CHECK( ! successor_ran);
+    EE_CHECK(sibling_ran);
+}
+
+} // namespace
+
+int main() {
+    ThreadPool pool(4);
+
+    ordering(pool);
+    cycles(pool);
+    failures(pool);
+
+    return ee::test::result("task_graph");
+}
@@ -0,0 +1,648 @@
+/**
+ * Copyright (c) 2017-2018 Gauthier ARNOULD
+ * This file is released under the zlib License (Zlib).
+ * See file LICENSE or go to https://opensource.org/licenses/Zlib
+ * for full license details.
+ */
+
+/**
+ * ThreadPool behavior: thread_ids, submissions from workers and from several
+ * outside threads at once, post_n, placements, idle policies, timers,
+ * inline overflow, joining with tasks queued or being submitted.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../ThreadPool.hpp"
+#include "../WorkerLocal.hpp"
+#include "check.hpp"
+
+namespace {
+
+using ee::ThreadPool;
+
+void thread_ids() {
+    ThreadPool pool(3);
+
+    std::vector<ee::Future<std::size_t>> futures;
+
+    for (int i = 0; i < 100; ++ i) {
+        futures.push_back(pool.arun([](std::size_t thread_id) { return thread_id; }));
+    }
+
+    pool.assist();
+
+    for (auto& future : futures) {
+        EE_CHECK(future.get() <= pool.worker_count());
+    }
+
+    auto blocking = pool.arun_blocking([](std::size_t thread_id) { return thread_id; });
+
+    EE_CHECK(blocking.get() == ThreadPool::blocking_thread_id);
+}
+
+// waits time out while the task is held, then report it ready
+void future_waits() {
+    using namespace std::chrono;
+
+    ThreadPool pool(2);
+
+    std::atomic<bool> release{false};
+
+    auto future = pool.arun([&](std::size_t) {
+        while ( ! release) {
+            std::this_thread::yield();
+        }
+
+        return 7;
+    });
+
+    EE_CHECK(future.wait_for(milliseconds(5)) == std::future_status::timeout);
+    EE_CHECK(future.wait_until(steady_clock::now() + milliseconds(5)) == std::future_status::timeout);
+
+    release = true;
+
+    EE_CHECK(future.wait_for(seconds(5)) == std::future_status::ready);
+    EE_CHECK(future.wait_until(steady_clock::now()) == std::future_status::ready);
+    EE_CHECK(future.is_ready());
+    EE_CHECK(future.get() == 7);
+    EE_CHECK( ! future.valid());
+}
+
+// tasks submitted from a worker go to its own deque and are stolen by others
+void nested_submissions() {
+    ThreadPool pool(4);
+
+    std::atomic<std::size_t> leaves{0};
+
+    auto root = pool.arun([&](std::size_t) {
+        std::vector<ee::Future<void>> children;
+
+        for (int i = 0; i < 64; ++ i) {
+            children.push_back(pool.arun([&](std::size_t) {
+                for (int j = 0; j < 64; ++ j) {
+                    pool.arun([&](std::size_t) { ++ leaves; });
+                }
+            }));
+        }
+
+        for (auto& child : children) {
+            child.get();
+        }
+    });
+
+    root.get();
+    pool.wait_completion();
+
+    EE_CHECK(leaves == 64 * 64);
+}
+
+// every i runs once, from outside and from a worker, throwing tasks dropped
+void post_n() {
+    ThreadPool pool(3);
+
+    for (std::size_t count : {0, 1, 7, 1000}) {
+        std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count + 1]());
+
+        pool.post_n(count, [&](std::size_t, std::size_t i) { ++ visits[i]; });
+        pool.wait_completion();
+
+        bool once = true;
+
+        for (std::size_t i = 0; i < count; ++ i) {
+            once = once && visits[i] == 1;
+        }
+
+        EE_CHECK(once);
+    }
+
+    std::atomic<int> ran{0};
+
+    pool.arun([&](std::size_t) {
+        pool.post_n(100, [&](std::size_t, std::size_t i) {
+            ++ ran;
+
+            if (i % 10 == 0) {
+                throw std::runtime_error("post_n");
+            }
+        });
+    });
+
+    pool.wait_completion();
+
+    EE_CHECK(ran == 100);
+}
+
+// pinned workers run on one core each, their nodes in range and grouped
+// together with Compact
+void placements() {
+    for (auto placement : {ThreadPool::Placement::None, ThreadPool::Placement::Compact, ThreadPool::Placement::Scatter}) {
+        ThreadPool pool(4, placement);
+
+        EE_CHECK(pool.node_count() >= 1);
+        EE_CHECK(placement != ThreadPool::Placement::None || pool.node_count() == 1);
+        EE_CHECK(pool.node_id(pool.worker_count()) == 0);
+        EE_CHECK(pool.node_id(ThreadPool::blocking_thread_id) == 0);
+
+        for (std::size_t t = 0; t < pool.worker_count(); ++ t) {
+            EE_CHECK(pool.node_id(t) < pool.node_count());
+            EE_CHECK(placement != ThreadPool::Placement::Compact || t == 0 || pool.node_id(t - 1) <= pool.node_id(t) ||
+                     pool.node_id(t) == 0);
+        }
+
+#if defined(__linux__)
+        std::atomic<bool> unpinned{false};
+
+        ee::TaskGroup group(pool);
+
+        group.run_n(64, [&](std::size_t thread_id, std::size_t) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+
+            if (thread_id < pool.worker_count() &&
+                pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0 && CPU_COUNT(&set) != 1) {
+                unpinned = true;
+            }
+        });
+        group.wait();
+
+        EE_CHECK(placement == ThreadPool::Placement::None || ! unpinned);
+#endif
+
+        std::atomic<std::size_t> sum{0};
+
+        ee::split_for(pool, 1000, 1, 0, 1, ee::Schedule::Static, [&](std::size_t, std::size_t j) { sum += j; });
+
+        EE_CHECK(sum == 999 * 1000 / 2);
+    }
+}
+
+// outside threads share the assisting thread_id, one at a time
+void concurrent_callers() {
+    ThreadPool pool(2);
+    ee::WorkerLocal<std::size_t> counts(pool, 0);
+
+    std::vector<std::thread> callers;
+
+    for (int t = 0; t < 4; ++ t) {
+        callers.emplace_back([&] {
+            for (int round = 0; round < 50; ++ round) {
+                ee::TaskGroup group(pool);
+
+                group.run_n(100, [&](std::size_t thread_id, std::size_t) {
+                    ++ counts[thread_id];
+                    pool.arena(thread_id).allocate(16);
+                });
+
+                group.wait();
+            }
+        });
+    }
+
+    for (auto& caller : callers) {
+        caller.join();
+    }
+
+    EE_CHECK(counts.combine(std::size_t{0}, [](std::size_t a, std::size_t b) { return a + b; }) == 4 * 50 * 100);
+
+    // groups are done before their last tasks return to the pool
+    pool.wait_completion();
+    pool.reset_arenas();
+}
+
+// which phase of the idle policy ends the waits for a trickle of tasks
+void idle_policies() {
+    using namespace std::chrono;
+
+    ThreadPool pool(1);
+
+    EE_CHECK(pool.idle_policy().spins == ThreadPool::IdlePolicy{}.spins);
+    EE_CHECK(pool.idle_policy().yields == ThreadPool::IdlePolicy{}.yields);
+
+    auto trickle = [&pool] {
+        // the wait going on may have started under the previous policy
+        pool.arun([](std::size_t) {}).get();
+        std::this_thread::sleep_for(milliseconds(1));
+
+        const ThreadPool::IdleStats before = pool.idle_stats();
+
+        for (int i = 0; i < 20; ++ i) {
+            pool.arun([](std::size_t) {}).get();
+            std::this_thread::sleep_for(microseconds(200));
+        }
+
+        const ThreadPool::IdleStats after = pool.idle_stats();
+
+        return ThreadPool::IdleStats{after.spun - before.spun, after.yielded - before.yielded, after.parked - before.parked};
+    };
+
+    // parking at once
+    pool.set_idle_policy({0, 0});
+
+    EE_CHECK(pool.idle_policy().spins == 0 && pool.idle_policy().yields == 0);
+
+    const ThreadPool::IdleStats parking = trickle();
+
+    EE_CHECK(parking.spun == 0 && parking.yielded == 0);
+    EE_CHECK(parking.parked > 0);
+
+    // spinning long enough to see every task come
+    pool.set_idle_policy({std::size_t{1} << 26, 0});
+
+    const ThreadPool::IdleStats spinning = trickle();
+
+    EE_CHECK(spinning.spun > 0);
+    EE_CHECK(spinning.yielded == 0);
+
+    pool.set_idle_policy({});
+}
+
+// idle workers retire down to min_workers, a burst queued behind a long task
+// gets one back after grow_after however few tasks it has
+void elastic() {
+    using namespace std::chrono;
+
+    ThreadPool pool(4);
+
+    pool.set_elastic_policy({1, milliseconds(5), microseconds(1000)});
+
+    const auto deadline = steady_clock::now() + seconds(5);
+
+    while (pool.active_workers() > 1 && steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+
+    EE_CHECK(pool.active_workers() == 1);
+
+    std::atomic<bool> release{false};
+    std::atomic<bool> long_started{false};
+
+    pool.arun([&](std::size_t) {
+        long_started = true;
+
+        while ( ! release && steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+    });
+
+    while ( ! long_started) {
+        std::this_thread::yield();
+    }
+
+    const auto start = steady_clock::now();
+    std::vector<ee::Future<steady_clock::duration>> burst;
+
+    for (int i = 0; i < 5; ++ i) {
+        burst.push_back(pool.arun([start](std::size_t) { return steady_clock::now() - start; }));
+    }
+
+    // the long task holds its worker until every task of the burst ran
+    for (auto& future : burst) {
+        EE_CHECK(future.get() < milliseconds(500));
+    }
+
+    release = true;
+    pool.wait_completion();
+
+    EE_CHECK(pool.active_workers() >= 2);
+}
+
+// timers fire in due order, cancelled ones never, periodic ones until
+// cancelled even when they throw
+void timers() {
+    using namespace std::chrono;
+
+    ThreadPool pool(2);
+
+    std::mutex mutex;
+    std::vector<int> order;
+
+    auto record = [&](int i) {
+        return [&, i](std::size_t) {
+            std::unique_lock<std::mutex> lock(mutex);
+            order.push_back(i);
+        };
+    };
+
+    pool.run_after(milliseconds(60), record(3));
+    pool.run_at(ThreadPool::Clock::now() + milliseconds(20), record(1));
+    pool.run_after(milliseconds(40), record(2));
+
+    const auto cancelled = pool.run_after(milliseconds(30), record(0));
+
+    EE_CHECK(cancelled != 0);
+    EE_CHECK(pool.cancel(cancelled));
+    EE_CHECK( ! pool.cancel(cancelled));
+
+    std::atomic<int> ticks{0};
+
+    const auto periodic = pool.run_every(milliseconds(2), [&](std::size_t) {
+        if (++ ticks % 2 == 0) {
+            throw std::runtime_error("tick");
+        }
+    });
+
+    const auto deadline = steady_clock::now() + seconds(5);
+
+    auto recorded = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        return order.size();
+    };
+
+    while ((ticks < 10 || recorded() < 3) && steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+
+    EE_CHECK(pool.cancel(periodic));
+
+    pool.wait_completion();
+
+    const int stopped = ticks;
+
+    std::this_thread::sleep_for(milliseconds(20));
+    pool.wait_completion();
+
+    EE_CHECK(ticks >= 10);
+    EE_CHECK(ticks == stopped);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    EE_CHECK(order == std::vector<int>({1, 2, 3}));
+}
+
+void priorities() {
+    ThreadPool pool(2);
+
+    auto high = pool.arun(ThreadPool::Priority::High, [](std::size_t, int a) { return a; }, 1);
+    auto low = pool.arun(ThreadPool::Priority::Low, [](std::size_t, int a) { return a; }, 2);
+
+    EE_CHECK(high.get() == 1);
+    EE_CHECK(low.get() == 2);
+
+    ee::CancelToken token;
+
+    auto before = pool.arun(token, ThreadPool::Priority::High, [](std::size_t) { return 3; });
+
+    EE_CHECK(before.get() == 3);
+
+    token.cancel();
+
+    auto after = pool.arun(token, ThreadPool::Priority::Low, [](std::size_t) { return 4; });
+    bool cancelled = false;
+
+    try {
+        after.get();
+    }
+    catch (const ee::Cancelled&) {
+        cancelled = true;
+    }
+
+    EE_CHECK(cancelled);
+}
+
+// a lane without budget keeps its tasks until the pool is joined
+void join_modes() {
+    {
+        ThreadPool pool(2);
+        pool.set_lane_budget(ThreadPool::Priority::Low, 0);
+
+        auto future = pool.arun(ThreadPool::Priority::Low, [](std::size_t) { return 5; });
+
+        pool.join(ThreadPool::JoinMode::Drain);
+
+        EE_CHECK(future.get() == 5);
+    }
+
+    {
+        ThreadPool pool(2);
+        pool.set_lane_budget(ThreadPool::Priority::Low, 0);
+
+        std::atomic<int> ran{0};
+        std::vector<ee::Future<void>> futures;
+
+        for (int i = 0; i < 100; ++ i) {
+            futures.push_back(pool.arun(ThreadPool::Priority::Low, [&](std::size_t) { ++ ran; }));
+        }
+
+        pool.join(ThreadPool::JoinMode::Discard);
+
+        EE_CHECK(ran == 0);
+
+        for (auto& future : futures) {
+            bool dropped = false;
+
+            try {
+                future.get();
+            }
+            catch (const std::future_error&) {
+                dropped = true;
+            }
+
+            EE_CHECK(dropped);
+        }
+    }
+}
+
+// a task keeps feeding the blocking lane while the pool joins
+void join_blocking_lane() {
+    ThreadPool pool(2);
+
+    std::atomic<int> accepted{0};
+    std::atomic<int> ran{0};
+    std::atomic<bool> started{false};
+
+    pool.arun([&](std::size_t) {
+        const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+
+        started = true;
+
+        while (std::chrono::steady_clock::now() < end) {
+            auto future = pool.arun_blocking([&](std::size_t) { ++ ran; });
+
+            try {
+                future.get();
+                ++ accepted;
+            }
+            catch (const std::future_error&) {}
+        }
+    });
+
+    while ( ! started) {
+        std::this_thread::yield();
+    }
+
+    pool.join();
+
+    EE_CHECK(pool.blocking_threads() == 0);
+    EE_CHECK(ran == accepted);
+}
+
+// tasks not fitting a full ring run on their submitter, with its thread_id
+void overflow_inline() {
+    ThreadPool pool(1, ThreadPool::Placement::None, {4, ThreadPool::Overflow::Inline});
+
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+
+    auto holder = pool.arun([&](std::size_t) {
+        started = true;
+
+        while ( ! release) {
+            std::this_thread::yield();
+        }
+    });
+
+    while ( ! started) {
+        std::this_thread::yield();
+    }
+
+    const auto caller = std::this_thread::get_id();
+    std::atomic<int> inline_runs{0};
+    std::vector<ee::Future<std::size_t>> futures;
+
+    for (int i = 0; i < 20; ++ i) {
+        futures.push_back(pool.arun([&, caller](std::size_t thread_id) {
+            if (std::this_thread::get_id() == caller) {
+                ++ inline_runs;
+            }
+
+            return thread_id;
+        }));
+    }
+
+    // the worker is held, whatever ran did so inline
+    EE_CHECK(inline_runs >= 20 - 4);
+
+    for (auto& future : futures) {
+        if (future.is_ready()) {
+            EE_CHECK(future.get() == pool.worker_count());
+        }
+    }
+
+    release = true;
+    holder.get();
+
+    for (auto& future : futures) {
+        if (future.valid()) {
+            EE_CHECK(future.get() < pool.worker_count());
+        }
+    }
+
+    // a worker overflowing the ring runs the task itself, the queued ones
+    // waiting for it to be done
+    auto nested = pool.arun([&](std::size_t outer) {
+        std::vector<ee::Future<bool>> inner;
+
+        for (int i = 0; i < 20; ++ i) {
+            inner.push_back(pool.arun([outer](std::size_t thread_id) { return thread_id == outer; }));
+        }
+
+        int own = 0;
+
+        for (auto& future : inner) {
+            own += future.is_ready() && future.get();
+        }
+
+        return own;
+    });
+
+    EE_CHECK(nested.get() >= 20 - 4);
+
+    pool.wait_completion();
+}
+
+/**
+ * Join while outside threads keep submitting: every task is either run or
+ * dropped, none is left behind, then the pool is restarted for the rest.
+ */
+void join_while_submitting(ThreadPool::QueuePolicy policy, ThreadPool::JoinMode mode) {
+    ThreadPool pool(2, ThreadPool::Placement::None, policy);
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> submitted{0};
+    std::atomic<std::size_t> destroyed{0};
+
+    struct Tracked {
+        explicit Tracked(std::atomic<std::size_t>& count) :
+            count{&count} {}
+
+        Tracked(Tracked&& other) :
+            count{other.count} {
+            other.count = nullptr;
+        }
+
+        ~Tracked() {
+            if (count) {
+                ++ *count;
+            }
+        }
+
+        std::atomic<std::size_t>* count;
+    };
+
+    std::vector<std::thread> submitters;
+
+    for (int t = 0; t < 3; ++ t) {
+        submitters.emplace_back([&] {
+            for (int i = 0; i < 5000 && ! stop; ++ i) {
+                ++ submitted;
+                pool.arun([tracked = Tracked{destroyed}](std::size_t) {});
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    pool.join(mode);
+
+    stop = true;
+    pool.spawn(2);
+
+    for (auto& submitter : submitters) {
+        submitter.join();
+    }
+
+    pool.join();
+
+    EE_CHECK(destroyed == submitted);
+}
+
+} // namespace
+
+int main() {
+    thread_ids();
+    future_waits();
+    nested_submissions();
+    post_n();
+    placements();
+    concurrent_callers();
+    idle_policies();
+    elastic();
+    timers();
+    priorities();
+    join_modes();
+    join_blocking_lane();
+    overflow_inline();
+
+    for (int round = 0; round < 5; ++ round) {
+        for (auto mode : {ThreadPool::JoinMode::Drain, ThreadPool::JoinMode::Discard}) {
+            join_while_submitting({}, mode);
+            join_while_submitting({64, ThreadPool::Overflow::Block}, mode);
+            join_while_submitting({64, ThreadPool::Overflow::Spin}, mode);
+        }
+    }
+
+    return ee::test::result("thread_pool");
+}